@@ -14,12 +14,95 @@
 #include "SPI.h"
 #include "analog.h"
 #include "median.h"
+#include "filter.h"
+#include "OS.h"
 #include "MK70F12.h"
 
-TAnalogInput Analog_Input[ANALOG_NB_INPUTS]; 	/*!< Passing the no. of analog inputs to the struct */
+#if ANALOG_WINDOW_SIZE == 3
+#define MEDIAN_NETWORK Median_Network3
+#elif ANALOG_WINDOW_SIZE == 5
+#define MEDIAN_NETWORK Median_Network5
+#elif ANALOG_WINDOW_SIZE == 7
+#define MEDIAN_NETWORK Median_Network7
+#elif ANALOG_WINDOW_SIZE == 9
+#define MEDIAN_NETWORK Median_Network9
+#elif ANALOG_WINDOW_SIZE == 11
+#define MEDIAN_NETWORK Median_Network11
+#endif
+
+TAnalogInput Analog_Input; 	/*!< The analog input channels, one per scan list entry */
+
+static uint8_t PendingChannelNb;		/*!< The entry of the conversion in progress, ANALOG_NB_INPUTS if none */
+
+// The UNI bit of a command word, set for the unipolar spans
+#define ANALOG_UNIPOLAR_MASK 0x0800
+
+/*! @brief Clears the sliding window and sets up the state of a filter.
+ *
+ *  @param channelNb is the scan list entry of the analog input channel.
+ *  @param filter is the filter to apply.
+ *  @param parameter is the filter parameter, already validated.
+ *  @return void.
+ */
+static void ResetFilter(const uint8_t channelNb, const TAnalogFilter filter, const uint8_t parameter)
+{
+  TAnalogFilterState* const state = &Analog_Input.state[channelNb];
+
+  // An all-zero window is consistent with an all-zero state for every filter
+  for (uint8_t sampleCount = 0; sampleCount < ANALOG_WINDOW_SIZE; sampleCount++)
+    Analog_Input.values[channelNb][sampleCount] = 0;
+
+  switch (filter)
+  {
+    case ANALOG_FILTER_AVERAGE:
+      state->average.sum = 0;
+      break;
+    case ANALOG_FILTER_IIR:
+      state->iir.output = 0;
+      state->iir.alpha = (uint16_t)parameter << 7;
+      break;
+    case ANALOG_FILTER_CIC:
+      for (uint8_t stage = 0; stage < FILTER_CIC_ORDER; stage++)
+      {
+        state->cic.integrators[stage] = 0;
+        state->cic.combs[stage] = 0;
+      }
+      state->cic.count = 0;
+      state->cic.log2Rate = parameter;
+      break;
+    default:
+#ifndef ANALOG_MEDIAN_NETWORK
+      for (uint8_t sampleCount = 0; sampleCount < ANALOG_WINDOW_SIZE; sampleCount++)
+        state->sorted[sampleCount] = 0;
+#endif
+      break;
+  }
+  Analog_Input.filter[channelNb] = filter;
+}
+
+/*! @brief Builds the LTC1859 command word for a scan list entry.
+ *
+ *  @param inputNb is the input, or the input pair for differential mode.
+ *  @param span is the input span.
+ *  @param mode selects a single-ended input or a differential pair.
+ *  @return uint16_t - The command word, in the upper byte of the exchange.
+ */
+static uint16_t Command(const uint8_t inputNb, const TAnalogSpan span, const TAnalogMode mode)
+{
+  uint8_t command;
+
+  // SGL/DIFF, ODD/SIGN, SELECT1, SELECT0, UNI, GAIN, NAP, SLEEP
+  command = ((mode == ANALOG_MODE_SINGLE_ENDED) ? 0x80 : 0x00)
+	  | ((inputNb & 0x01) << 6)
+	  | ((inputNb >> 1) << 4)
+	  | ((uint8_t)span << 2);
+
+  return (uint16_t)command << 8;
+}
 
 /*! @brief Sets up the ADC before first use.
  *
+ *  The scan list starts with inputs 0 and 1, single-ended on the +/- 10V span.
  *  @param moduleClk The module clock rate in Hz.
  *  @return BOOL - true if the UART was successfully initialized.
  */
@@ -39,76 +122,248 @@ BOOL Analog_Init(const uint32_t moduleClock)
   // Call SPI Module
   valid = SPI_Init(&aSPIModule, moduleClock);
 
+  // No conversion has been started yet
+  PendingChannelNb = ANALOG_NB_INPUTS;
+
   // Sets a value to the analog input structures
   for (uint8_t channelNb = 0; channelNb < ANALOG_NB_INPUTS; channelNb++)
   {
     // The current analog value is set to 0
-    Analog_Input[channelNb].value.l = 0;
+    Analog_Input.value[channelNb].l = 0;
     // The previous analog value is set to 0
-    Analog_Input[channelNb].oldValue.l = 0;
+    Analog_Input.oldValue[channelNb].l = 0;
+    Analog_Input.sample[channelNb] = 0;
 
-    for (uint8_t sampleCount = 0; sampleCount < ANALOG_WINDOW_SIZE; sampleCount++)
-    {
-      // The sliding window value is set to 0
-      Analog_Input[channelNb].values[sampleCount] = 0;
-    }
-    Analog_Input[channelNb].putPtr = &(Analog_Input[channelNb].values[0]);
+    // Every change is reported by default
+    Analog_Input.reported[channelNb] = 0;
+    Analog_Input.deadband[channelNb] = 0;
+    Analog_Input.minInterval[channelNb] = 0;
+    Analog_Input.sinceReport[channelNb] = 0;
+    Analog_Input.nbReports[channelNb] = 0;
+    Analog_Input.nbChanges[channelNb] = 0;
+
+    // The sliding window is cleared and the median filter is used by default
+    ResetFilter(channelNb, ANALOG_FILTER_MEDIAN, 0);
+
+    // Single-Ended Channel Selection (+ / - 10V)
+    Analog_Input.command[channelNb] = Command(channelNb, ANALOG_SPAN_BIPOLAR_10V, ANALOG_MODE_SINGLE_ENDED);
   }
+  Analog_Input.putIndex = 0;
+  Analog_Input.nbChannels = 2;
+
   return valid;
 }
 
-/*! @brief Takes a sample from an analog input channel.
+/*! @brief Sets an entry of the scan list.
+ *
+ *  Entries are written in order; writing entry n makes it the last entry of the list.
+ *  @param channelNb is the scan list entry, up to the current number of entries.
+ *  @param inputNb is the LTC1859 input, or the input pair for differential mode (0 to 7).
+ *  @param span is the input span.
+ *  @param mode selects a single-ended input or a differential pair.
+ *  @return BOOL - true if the entry was set.
+ *  @note The entry's window is cleared and its filter set back to the median. Unipolar samples
+ *        are halved, so 0 to full scale reads 0 to 32767 like the positive half of a bipolar span.
+ */
+BOOL Analog_SetScan(const uint8_t channelNb, const uint8_t inputNb, const TAnalogSpan span, const TAnalogMode mode)
+{
+  if ((channelNb >= ANALOG_NB_INPUTS) || (channelNb > Analog_Input.nbChannels) || (inputNb > 7))
+    return bFALSE;
+
+  if ((span > ANALOG_SPAN_UNIPOLAR_10V) || (mode > ANALOG_MODE_DIFFERENTIAL))
+    return bFALSE;
+
+  // The DAC thread must not scan while the list is changed
+  OS_DisableInterrupts();
+
+  Analog_Input.command[channelNb] = Command(inputNb, span, mode);
+  Analog_Input.nbChannels = channelNb + 1;
+  Analog_Input.value[channelNb].l = 0;
+  Analog_Input.oldValue[channelNb].l = 0;
+  Analog_Input.sample[channelNb] = 0;
+  Analog_Input.reported[channelNb] = 0;
+  Analog_Input.sinceReport[channelNb] = 0;
+  ResetFilter(channelNb, ANALOG_FILTER_MEDIAN, 0);
+
+  // The conversion in progress may belong to an entry that has changed
+  PendingChannelNb = ANALOG_NB_INPUTS;
+
+  OS_EnableInterrupts();
+
+  return bTRUE;
+}
+
+/*! @brief Samples every channel in the scan list and filters them in one pass.
  *
- *  @param channelNb is the number of the analog input channel to sample.
- *  @return BOOL - true if the channel was read successfully.
+ *  The LTC1859 returns the previous conversion while the next command is clocked in, so each
+ *  exchange starts the conversion for one entry and reads back the conversion started for the
+ *  entry before it.
+ *  @return BOOL - true if the channels were read successfully.
+ *  @note The sample for the last entry is collected by the first exchange of the next scan.
  */
-BOOL Analog_Get(const uint8_t channelNb)
+BOOL Analog_Scan(void)
 {
+  uint16_t result;
+  int16_t oldestValue;
+  int16_t newValue;
+
   // Selects DEC7
   SPI_SelectSlaveDevice(7);
-  // Channel address
-  uint16_t address;
 
-  switch (channelNb)
+  for (uint8_t channelNb = 0; channelNb < Analog_Input.nbChannels; channelNb++)
   {
-    case 0:
-      // Channel 0
-      // Single-Ended Channel Selection (+ / - 10V)
-      address = 0x8400;
-      break;
-    case 1:
-      // Channel 1
-      // Single-Ended Channel Selection (+ / - 10V)
-      address = 0xC400;
-      break;
-    default:
-      return bFALSE;
+    // Start conversion N+1 and receive the result of conversion N
+    SPI_ExchangeChar(Analog_Input.command[channelNb], &result);
+
+    // The first exchange after start-up has no conversion behind it
+    if (PendingChannelNb < ANALOG_NB_INPUTS)
+    {
+      // Unipolar results are straight binary; halved, they stay positive and on the scale of the bipolar span
+      if (Analog_Input.command[PendingChannelNb] & ANALOG_UNIPOLAR_MASK)
+        Analog_Input.sample[PendingChannelNb] = (int16_t)(result >> 1);
+      else
+        Analog_Input.sample[PendingChannelNb] = (int16_t)result;
+    }
+
+    PendingChannelNb = channelNb;
   }
 
-  uint16_t *value;
+  // Every channel's window advances together
+  if (Analog_Input.putIndex == ANALOG_WINDOW_SIZE - 1)
+    Analog_Input.putIndex = 0;
+  else
+    Analog_Input.putIndex++;
 
-  // Checks if the analog input values is accordance to the window size (array - 1)
-  if (Analog_Input[channelNb].putPtr == &(Analog_Input[channelNb].values[ANALOG_WINDOW_SIZE - 1]))
+  for (uint8_t channelNb = 0; channelNb < Analog_Input.nbChannels; channelNb++)
   {
-    // The current value is set to zero which points to the required channel
-    Analog_Input[channelNb].putPtr = &(Analog_Input[channelNb].values[0]);
+    TAnalogFilterState* const state = &Analog_Input.state[channelNb];
+
+    // The sample about to be overwritten is the oldest in the window
+    newValue = Analog_Input.sample[channelNb];
+    oldestValue = Analog_Input.values[channelNb][Analog_Input.putIndex];
+    Analog_Input.values[channelNb][Analog_Input.putIndex] = newValue;
+
+    //updates the old Vale to the value previously sampled
+    Analog_Input.oldValue[channelNb] = Analog_Input.value[channelNb];
+
+    switch (Analog_Input.filter[channelNb])
+    {
+      case ANALOG_FILTER_AVERAGE:
+	Analog_Input.value[channelNb].l = Filter_Average(&state->average, ANALOG_WINDOW_SIZE, oldestValue, newValue);
+	break;
+      case ANALOG_FILTER_IIR:
+	Analog_Input.value[channelNb].l = Filter_IIR(&state->iir, newValue);
+	break;
+      case ANALOG_FILTER_CIC:
+	// The value is held between decimated outputs
+	(void)Filter_CIC(&state->cic, newValue, &Analog_Input.value[channelNb].l);
+	break;
+      default:
+	// stores the median value of the array
+#ifdef ANALOG_MEDIAN_NETWORK
+	Analog_Input.value[channelNb].l = MEDIAN_NETWORK(Analog_Input.values[channelNb]);
+#else
+	Analog_Input.value[channelNb].l = Median_Update(state->sorted, ANALOG_WINDOW_SIZE, oldestValue, newValue);
+#endif
+	break;
+    }
   }
-  else
+
+  return bTRUE;
+}
+
+/*! @brief Selects the filter applied to an analog input channel.
+ *
+ *  @param channelNb is the scan list entry of the analog input channel.
+ *  @param filter is the filter to apply.
+ *  @param parameter is the IIR smoothing factor in Q8 (1 to 255) or the CIC decimation rate
+ *         as a power of two (1 to FILTER_CIC_MAX_LOG2_RATE), and 0 for the other filters.
+ *  @return BOOL - true if the filter was selected.
+ *  @note The sliding window and the filter state are cleared.
+ */
+BOOL Analog_SetFilter(const uint8_t channelNb, const TAnalogFilter filter, const uint8_t parameter)
+{
+  if (channelNb >= ANALOG_NB_INPUTS)
+    return bFALSE;
+
+  switch (filter)
   {
-    Analog_Input[channelNb].putPtr++;
+    case ANALOG_FILTER_MEDIAN:
+    case ANALOG_FILTER_AVERAGE:
+      if (parameter != 0)
+        return bFALSE;
+      break;
+    case ANALOG_FILTER_IIR:
+      if (parameter == 0)
+        return bFALSE;
+      break;
+    case ANALOG_FILTER_CIC:
+      if ((parameter == 0) || (parameter > FILTER_CIC_MAX_LOG2_RATE))
+        return bFALSE;
+      break;
+    default:
+      return bFALSE;
   }
 
-  // Send command
-  SPI_ExchangeChar(address, Analog_Input[channelNb].putPtr);
+  // The DAC thread must not sample the channel while its state is cleared
+  OS_DisableInterrupts();
+  ResetFilter(channelNb, filter, parameter);
+  OS_EnableInterrupts();
+
+  return bTRUE;
+}
+
+/*! @brief Sets when changes of an analog input channel are reported.
+ *
+ *  @param channelNb is the scan list entry of the analog input channel.
+ *  @param deadband is the change from the last reported value needed for a new report.
+ *  @param minInterval is the minimum number of scans between reports.
+ *  @return BOOL - true if the channel was valid.
+ *  @note The report statistics of the channel are cleared.
+ */
+BOOL Analog_SetReport(const uint8_t channelNb, const uint8_t deadband, const uint8_t minInterval)
+{
+  if (channelNb >= ANALOG_NB_INPUTS)
+    return bFALSE;
+
+  Analog_Input.deadband[channelNb] = deadband;
+  Analog_Input.minInterval[channelNb] = minInterval;
+  Analog_Input.nbReports[channelNb] = 0;
+  Analog_Input.nbChanges[channelNb] = 0;
+
+  return bTRUE;
+}
+
+/*! @brief Decides whether a change of an analog input channel should be reported.
+ *
+ *  A report is due when the value has moved more than the deadband away from the value last
+ *  reported and at least the minimum interval has passed since then.
+ *  @param channelNb is the scan list entry of the analog input channel.
+ *  @return BOOL - true if the current value should be sent; it is then taken as reported.
+ *  @note Called once per scan for each channel.
+ */
+BOOL Analog_ReportDue(const uint8_t channelNb)
+{
+  int32_t change;
+
+  if (Analog_Input.sinceReport[channelNb] < UINT8_MAX)
+    Analog_Input.sinceReport[channelNb]++;
+
+  // Every change would have been reported without the deadband and interval
+  if (Analog_Input.value[channelNb].l != Analog_Input.oldValue[channelNb].l)
+    Analog_Input.nbChanges[channelNb]++;
 
-  // Receive response to command
-  SPI_ExchangeChar(address, Analog_Input[channelNb].putPtr);
+  change = (int32_t)Analog_Input.value[channelNb].l - Analog_Input.reported[channelNb];
+  if (change < 0)
+    change = -change;
 
-  //updates the old Vale to the value previously sampled
-  Analog_Input[channelNb].oldValue = Analog_Input[channelNb].value;
+  // Movement inside the deadband is taken as noise
+  if ((change <= Analog_Input.deadband[channelNb]) || (Analog_Input.sinceReport[channelNb] < Analog_Input.minInterval[channelNb]))
+    return bFALSE;
 
-  // stores the median value of the array
-  Analog_Input[channelNb].value.l = Median_Filter(Analog_Input[channelNb].values, ANALOG_WINDOW_SIZE);
+  Analog_Input.reported[channelNb] = Analog_Input.value[channelNb].l;
+  Analog_Input.sinceReport[channelNb] = 0;
+  Analog_Input.nbReports[channelNb]++;
 
   return bTRUE;
 }
@@ -13,38 +13,133 @@
 // new types
 #include "types.h"
 #include "SPI.h"
+#include "filter.h"
 
-// Maximum number of channels
-#define ANALOG_NB_INPUTS 2
+// Maximum number of entries in the scan list, one per LTC1859 input
+#define ANALOG_NB_INPUTS 8
 #define ANALOG_WINDOW_SIZE 5
 
+// Common window sizes use a fixed median network, other sizes keep a sorted copy of the window
+#if (ANALOG_WINDOW_SIZE == 3) || (ANALOG_WINDOW_SIZE == 5) || (ANALOG_WINDOW_SIZE == 7) || \
+    (ANALOG_WINDOW_SIZE == 9) || (ANALOG_WINDOW_SIZE == 11)
+#define ANALOG_MEDIAN_NETWORK
+#endif
+
+typedef enum
+{
+  ANALOG_FILTER_MEDIAN  = 0,
+  ANALOG_FILTER_AVERAGE = 1,
+  ANALOG_FILTER_IIR     = 2,
+  ANALOG_FILTER_CIC     = 3
+} TAnalogFilter;
+
+// LTC1859 input spans, encoded as the UNI and GAIN bits of the command
+typedef enum
+{
+  ANALOG_SPAN_BIPOLAR_5V   = 0,
+  ANALOG_SPAN_BIPOLAR_10V  = 1,
+  ANALOG_SPAN_UNIPOLAR_5V  = 2,
+  ANALOG_SPAN_UNIPOLAR_10V = 3
+} TAnalogSpan;
+
+typedef enum
+{
+  ANALOG_MODE_SINGLE_ENDED = 0,
+  ANALOG_MODE_DIFFERENTIAL = 1
+} TAnalogMode;
+
 #pragma pack(push)
 #pragma pack(2)
 
+typedef union
+{
+#ifndef ANALOG_MEDIAN_NETWORK
+  int16_t sorted[ANALOG_WINDOW_SIZE];  /*!< The sliding window kept in ascending order for the median. */
+#endif
+  TAverageFilter average;              /*!< The running sum for the moving average. */
+  TIIRFilter iir;                      /*!< The exponential smoothing state. */
+  TCICFilter cic;                      /*!< The integrator and comb stages of the CIC filter. */
+} TAnalogFilterState;
+
 typedef struct
 {
-  int16union_t value;                  /*!< The current "processed" analog value (the user updates this value). */
-  int16union_t oldValue;               /*!< The previous "processed" analog value (the user updates this value). */
-  int16_t values[ANALOG_WINDOW_SIZE];  /*!< An array of sample values to create a "sliding window". */
-  int16_t* putPtr;                     /*!< A pointer into the array of the last sample taken. */
+  int16union_t value[ANALOG_NB_INPUTS];                   /*!< The current "processed" analog values (the user updates these values). */
+  int16union_t oldValue[ANALOG_NB_INPUTS];                /*!< The previous "processed" analog values (the user updates these values). */
+  int16_t sample[ANALOG_NB_INPUTS];                       /*!< The raw samples collected by the last scan. */
+  int16_t values[ANALOG_NB_INPUTS][ANALOG_WINDOW_SIZE];   /*!< The "sliding window" of each channel. */
+  uint8_t putIndex;                                       /*!< The window position of the last sample taken, shared by all channels. */
+  TAnalogFilter filter[ANALOG_NB_INPUTS];                 /*!< The filter applied to each channel. */
+  TAnalogFilterState state[ANALOG_NB_INPUTS];             /*!< Only the state of the selected filter is in use. */
+  uint16_t command[ANALOG_NB_INPUTS];                     /*!< The LTC1859 command word of each scan list entry. */
+  uint8_t nbChannels;                                     /*!< The number of entries in the scan list. */
+  int16_t reported[ANALOG_NB_INPUTS];                     /*!< The value last reported to the PC. */
+  uint8_t deadband[ANALOG_NB_INPUTS];                     /*!< The change from the reported value needed for a new report. */
+  uint8_t minInterval[ANALOG_NB_INPUTS];                  /*!< The minimum number of scans between reports. */
+  uint8_t sinceReport[ANALOG_NB_INPUTS];                  /*!< The scans since the last report, saturating. */
+  uint16_t nbReports[ANALOG_NB_INPUTS];                   /*!< The number of changes reported, wrapping. */
+  uint16_t nbChanges[ANALOG_NB_INPUTS];                   /*!< The number of scans where the value changed at all, wrapping. */
 } TAnalogInput;
 
 #pragma pack(pop)
 
-extern TAnalogInput Analog_Input[ANALOG_NB_INPUTS];
+extern TAnalogInput Analog_Input;
 
 /*! @brief Sets up the ADC before first use.
  *
+ *  The scan list starts with inputs 0 and 1, single-ended on the +/- 10V span.
  *  @param moduleClk The module clock rate in Hz.
  *  @return BOOL - true if the UART was successfully initialized.
  */
 BOOL Analog_Init(const uint32_t moduleClock);
 
-/*! @brief Takes a sample from an analog input channel.
+/*! @brief Sets an entry of the scan list.
+ *
+ *  Entries are written in order; writing entry n makes it the last entry of the list.
+ *  @param channelNb is the scan list entry, up to the current number of entries.
+ *  @param inputNb is the LTC1859 input, or the input pair for differential mode (0 to 7).
+ *  @param span is the input span.
+ *  @param mode selects a single-ended input or a differential pair.
+ *  @return BOOL - true if the entry was set.
+ *  @note The entry's window is cleared and its filter set back to the median. Unipolar samples
+ *        are halved, so 0 to full scale reads 0 to 32767 like the positive half of a bipolar span.
+ */
+BOOL Analog_SetScan(const uint8_t channelNb, const uint8_t inputNb, const TAnalogSpan span, const TAnalogMode mode);
+
+/*! @brief Samples every channel in the scan list and filters them in one pass.
+ *
+ *  @return BOOL - true if the channels were read successfully.
+ */
+BOOL Analog_Scan(void);
+
+/*! @brief Selects the filter applied to an analog input channel.
+ *
+ *  @param channelNb is the scan list entry of the analog input channel.
+ *  @param filter is the filter to apply.
+ *  @param parameter is the IIR smoothing factor in Q8 (1 to 255) or the CIC decimation rate
+ *         as a power of two (1 to FILTER_CIC_MAX_LOG2_RATE), and 0 for the other filters.
+ *  @return BOOL - true if the filter was selected.
+ *  @note The sliding window and the filter state are cleared.
+ */
+BOOL Analog_SetFilter(const uint8_t channelNb, const TAnalogFilter filter, const uint8_t parameter);
+
+/*! @brief Sets when changes of an analog input channel are reported.
+ *
+ *  @param channelNb is the scan list entry of the analog input channel.
+ *  @param deadband is the change from the last reported value needed for a new report.
+ *  @param minInterval is the minimum number of scans between reports.
+ *  @return BOOL - true if the channel was valid.
+ *  @note The report statistics of the channel are cleared.
+ */
+BOOL Analog_SetReport(const uint8_t channelNb, const uint8_t deadband, const uint8_t minInterval);
+
+/*! @brief Decides whether a change of an analog input channel should be reported.
  *
- *  @param channelNb is the number of the analog input channel to sample.
- *  @return BOOL - true if the channel was read successfully.
+ *  A report is due when the value has moved more than the deadband away from the value last
+ *  reported and at least the minimum interval has passed since then.
+ *  @param channelNb is the scan list entry of the analog input channel.
+ *  @return BOOL - true if the current value should be sent; it is then taken as reported.
+ *  @note Called once per scan for each channel.
  */
-BOOL Analog_Get(const uint8_t channelNb);
+BOOL Analog_ReportDue(const uint8_t channelNb);
 
 #endif
@@ -0,0 +1,398 @@
+/*! @file
+ *
+ *  @brief Routines for measuring a signal on an analog input.
+ *
+ *  Implementation of functions for computing the mean, RMS, peak-to-peak and the Goertzel
+ *  magnitude and phase of a fundamental and its harmonics over blocks of samples.
+ *
+ *  @author Mohammad Yasin Azimi, Scott Williams
+ *  @date 2016-10-31
+ */
+/*!
+ * @addtogroup Analyzer_module Analyzer module documentation
+ * @{
+ */
+#include "analyzer.h"
+#include "analog.h"
+#include "packet.h"
+#include "OS.h"
+
+// Number of CORDIC iterations
+#define CORDIC_NB_STEPS 30
+// CORDIC gain compensation in Q30
+#define CORDIC_GAIN_Q30 652032874
+// Fraction bits of the Goertzel coefficients, leaving room for the states in 64 bits
+#define COEFFICIENT_BITS 24
+
+// atan(2^-i) in 1/2^32 of a turn
+static const int32_t CordicAngle[CORDIC_NB_STEPS] =
+{
+  536870912, 316933406, 167458907, 85004756, 42667331, 21354465, 10679838, 5340245,
+  2670163, 1335087, 667544, 333772, 166886, 83443, 41722, 20861,
+  10430, 5215, 2608, 1304, 652, 326, 163, 81,
+  41, 20, 10, 5, 3, 1
+};
+
+typedef struct
+{
+  int32_t cosine;				/*!< cos(w) in Q24 */
+  int32_t sine;					/*!< sin(w) in Q24 */
+  int64_t s1;					/*!< The last Goertzel state */
+  int64_t s2;					/*!< The Goertzel state before that */
+  BOOL active;					/*!< FALSE if the bin is at or above half the block length */
+} TBin;
+
+static uint8_t ChannelNb;			/*!< The scan list entry being measured */
+static uint16_t Length;				/*!< The number of samples in a block */
+static uint16_t Fundamental;			/*!< The fundamental in cycles per block */
+
+static uint16_t NbSamples;			/*!< The samples in the current block */
+static int32_t Sum;				/*!< The sum of the current block */
+static int64_t SumSquares;			/*!< The sum of squares of the current block */
+static int16_t Min;				/*!< The smallest sample of the current block */
+static int16_t Max;				/*!< The largest sample of the current block */
+static TBin Bins[ANALYZER_NB_BINS];		/*!< The Goertzel filters */
+
+static TAnalyzerResults Results;		/*!< The results of the last complete block */
+
+/*! @brief Finds the cosine and sine of an angle with CORDIC rotation.
+ *
+ *  @param angle is the angle in 1/2^32 of a turn.
+ *  @param cosine is where the cosine is stored in Q30.
+ *  @param sine is where the sine is stored in Q30.
+ *  @return void.
+ */
+static void CordicRotate(const uint32_t angle, int32_t* const cosine, int32_t* const sine)
+{
+  int32_t x = CORDIC_GAIN_Q30, y = 0, next;
+  int32_t z = (int32_t)angle;
+  BOOL flip = bFALSE;
+
+  // CORDIC converges within a quarter turn either side of zero
+  if (z > 0x40000000)
+  {
+    z -= 0x80000000;
+    flip = bTRUE;
+  }
+  else if (z < -0x40000000)
+  {
+    z += 0x80000000;
+    flip = bTRUE;
+  }
+
+  for (uint8_t i = 0; i < CORDIC_NB_STEPS; i++)
+  {
+    if (z >= 0)
+    {
+      next = x - (y >> i);
+      y += (x >> i);
+      z -= CordicAngle[i];
+    }
+    else
+    {
+      next = x + (y >> i);
+      y -= (x >> i);
+      z += CordicAngle[i];
+    }
+    x = next;
+  }
+
+  *cosine = flip ? -x : x;
+  *sine = flip ? -y : y;
+}
+
+/*! @brief Finds the magnitude and angle of a vector with CORDIC vectoring.
+ *
+ *  @param x is the real part.
+ *  @param y is the imaginary part.
+ *  @param angle is where the angle is stored in 1/65536 of a turn.
+ *  @return uint32_t - The magnitude of the vector.
+ *  @note The parts must be smaller than 2^29 in size.
+ */
+static uint32_t CordicVector(int32_t x, int32_t y, uint16_t* const angle)
+{
+  int32_t z = 0, next;
+
+  // Starts in the right half plane
+  if (x < 0)
+  {
+    x = -x;
+    y = -y;
+    z = (int32_t)0x80000000;
+  }
+
+  for (uint8_t i = 0; i < CORDIC_NB_STEPS; i++)
+  {
+    if (y > 0)
+    {
+      next = x + (y >> i);
+      y -= (x >> i);
+      z += CordicAngle[i];
+    }
+    else
+    {
+      next = x - (y >> i);
+      y += (x >> i);
+      z -= CordicAngle[i];
+    }
+    x = next;
+  }
+
+  *angle = (uint16_t)((uint32_t)z >> 16);
+  return (uint32_t)(((int64_t)x * CORDIC_GAIN_Q30) >> 30);
+}
+
+/*! @brief Integer square root.
+ *
+ *  @param value is the number whose square root is sought.
+ *  @return uint32_t - The square root rounded down.
+ */
+static uint32_t SquareRoot(uint64_t value)
+{
+  uint64_t root = 0, bit = (uint64_t)1 << 62;
+
+  while (bit > value)
+    bit >>= 2;
+
+  while (bit != 0)
+  {
+    if (value >= root + bit)
+    {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    }
+    else
+      root >>= 1;
+    bit >>= 2;
+  }
+
+  return (uint32_t)root;
+}
+
+/*! @brief Clears the accumulators and sets up the bins for a new block.
+ *
+ *  @return void.
+ */
+static void Restart(void)
+{
+  NbSamples = 0;
+  Sum = 0;
+  SumSquares = 0;
+  Min = INT16_MAX;
+  Max = INT16_MIN;
+
+  for (uint8_t binNb = 0; binNb < ANALYZER_NB_BINS; binNb++)
+  {
+    uint32_t cycles = (uint32_t)Fundamental * (binNb + 1);
+
+    Bins[binNb].s1 = 0;
+    Bins[binNb].s2 = 0;
+    Bins[binNb].active = (2 * cycles < Length);
+    if (Bins[binNb].active)
+    {
+      CordicRotate((uint32_t)(((uint64_t)cycles << 32) / Length), &Bins[binNb].cosine, &Bins[binNb].sine);
+      Bins[binNb].cosine >>= (30 - COEFFICIENT_BITS);
+      Bins[binNb].sine >>= (30 - COEFFICIENT_BITS);
+    }
+  }
+}
+
+/*! @brief Works out the results of a complete block.
+ *
+ *  @return void.
+ */
+static void Latch(void)
+{
+  uint64_t harmonics = 0;
+
+  Results.mean = (int16_t)(Sum / (int32_t)Length);
+  Results.rms = (uint16_t)SquareRoot((uint64_t)SumSquares / Length);
+  Results.peakToPeak = (uint16_t)((int32_t)Max - Min);
+  Results.nbBlocks++;
+
+  for (uint8_t binNb = 0; binNb < ANALYZER_NB_BINS; binNb++)
+  {
+    int32_t real, imaginary;
+    uint32_t magnitude;
+
+    if (!Bins[binNb].active)
+    {
+      Results.amplitude[binNb] = 0;
+      Results.phase[binNb] = 0;
+      continue;
+    }
+
+    // X = s1.e^jw - s2 for a whole number of cycles per block
+    real = (int32_t)(((Bins[binNb].s1 * Bins[binNb].cosine) >> COEFFICIENT_BITS) - Bins[binNb].s2);
+    imaginary = (int32_t)((Bins[binNb].s1 * Bins[binNb].sine) >> COEFFICIENT_BITS);
+
+    magnitude = CordicVector(real, imaginary, &Results.phase[binNb]);
+    Results.amplitude[binNb] = (uint16_t)((2 * (uint64_t)magnitude) / Length);
+
+    if (binNb > 0)
+      harmonics += (uint64_t)Results.amplitude[binNb] * Results.amplitude[binNb];
+  }
+
+  if (Results.amplitude[0] != 0)
+  {
+    uint32_t thd = (SquareRoot(harmonics) * 10000) / Results.amplitude[0];
+    Results.thd = (thd > UINT16_MAX) ? UINT16_MAX : (uint16_t)thd;
+  }
+  else
+    Results.thd = 0;
+}
+
+/*! @brief Sets up the analyzer before first use.
+ *
+ *  @return BOOL - TRUE if the analyzer was successfully initialized.
+ */
+BOOL Analyzer_Init(void)
+{
+  ChannelNb = 0;
+  Length = 1024;
+  Fundamental = 16;
+
+  Results.mean = 0;
+  Results.rms = 0;
+  Results.peakToPeak = 0;
+  Results.thd = 0;
+  Results.nbBlocks = 0;
+  for (uint8_t binNb = 0; binNb < ANALYZER_NB_BINS; binNb++)
+  {
+    Results.amplitude[binNb] = 0;
+    Results.phase[binNb] = 0;
+  }
+
+  Restart();
+
+  return bTRUE;
+}
+
+/*! @brief Configures the analyzer or sends the latest results.
+ *
+ *  @param control The analyzer control command.
+ *  @param data The data sent with the command.
+ *  @return BOOL - TRUE if the command was valid.
+ *  @note Changing the configuration restarts the current block.
+ */
+BOOL Analyzer_Control(const TAnalyzerControl control, const uint16union_t data)
+{
+  TAnalyzerResults results;
+  uint16union_t value;
+  BOOL valid = bTRUE;
+
+  // The DAC thread must not add samples while the configuration changes
+  OS_DisableInterrupts();
+
+  switch (control)
+  {
+    case ANALYZER_STATUS_CHECK:
+      break;
+    case ANALYZER_CHANNEL:
+      valid = (data.l < ANALOG_NB_INPUTS);
+      if (!valid)
+	break;
+      ChannelNb = (uint8_t)data.l;
+      Restart();
+      break;
+    case ANALYZER_LENGTH:
+      valid = (data.l >= 2) && (data.l <= ANALYZER_MAX_LENGTH);
+      if (!valid)
+	break;
+      Length = data.l;
+      Restart();
+      break;
+    case ANALYZER_FUNDAMENTAL:
+      valid = (data.l != 0);
+      if (!valid)
+	break;
+      Fundamental = data.l;
+      Restart();
+      break;
+    default:
+      valid = bFALSE;
+      break;
+  }
+
+  OS_EnableInterrupts();
+
+  if (valid && (control == ANALYZER_STATUS_CHECK))
+  {
+    Analyzer_Get(&results);
+
+    value.l = (uint16_t)results.mean;
+    Packet_Put(ANALYZER_COMMAND, ANALYZER_RESULT_MEAN, value.s.Lo, value.s.Hi);
+    value.l = results.rms;
+    Packet_Put(ANALYZER_COMMAND, ANALYZER_RESULT_RMS, value.s.Lo, value.s.Hi);
+    value.l = results.peakToPeak;
+    Packet_Put(ANALYZER_COMMAND, ANALYZER_RESULT_PEAK_TO_PEAK, value.s.Lo, value.s.Hi);
+    value.l = results.thd;
+    Packet_Put(ANALYZER_COMMAND, ANALYZER_RESULT_THD, value.s.Lo, value.s.Hi);
+    value.l = results.nbBlocks;
+    Packet_Put(ANALYZER_COMMAND, ANALYZER_RESULT_BLOCKS, value.s.Lo, value.s.Hi);
+
+    for (uint8_t binNb = 0; binNb < ANALYZER_NB_BINS; binNb++)
+    {
+      value.l = results.amplitude[binNb];
+      Packet_Put(ANALYZER_COMMAND, ANALYZER_RESULT_AMPLITUDE + binNb, value.s.Lo, value.s.Hi);
+      value.l = results.phase[binNb];
+      Packet_Put(ANALYZER_COMMAND, ANALYZER_RESULT_PHASE + binNb, value.s.Lo, value.s.Hi);
+    }
+  }
+
+  return valid;
+}
+
+/*! @brief Adds the samples from one scan of the analog inputs to the current block.
+ *
+ *  @param samples is the array of raw samples, indexed by scan list entry.
+ *  @return void.
+ *  @note Called once per scan. The results are latched at the end of each block.
+ */
+void Analyzer_Put(const int16_t samples[])
+{
+  int16_t sample = samples[ChannelNb];
+  int64_t s0;
+
+  Sum += sample;
+  SumSquares += (int32_t)sample * sample;
+  if (sample < Min)
+    Min = sample;
+  if (sample > Max)
+    Max = sample;
+
+  for (uint8_t binNb = 0; binNb < ANALYZER_NB_BINS; binNb++)
+  {
+    if (!Bins[binNb].active)
+      continue;
+
+    // s0 = x + 2cos(w).s1 - s2
+    s0 = sample + ((Bins[binNb].s1 * Bins[binNb].cosine) >> (COEFFICIENT_BITS - 1)) - Bins[binNb].s2;
+    Bins[binNb].s2 = Bins[binNb].s1;
+    Bins[binNb].s1 = s0;
+  }
+
+  NbSamples++;
+  if (NbSamples == Length)
+  {
+    Latch();
+    Restart();
+  }
+}
+
+/*! @brief Gets the results of the last complete block.
+ *
+ *  @param results is a pointer to where the results are copied.
+ *  @return void.
+ */
+void Analyzer_Get(TAnalyzerResults* const results)
+{
+  // The DAC thread latches results at the end of a block
+  OS_DisableInterrupts();
+  *results = Results;
+  OS_EnableInterrupts();
+}
+
+/*!
+ * @}
+ */
@@ -0,0 +1,85 @@
+/*! @file
+ *
+ *  @brief Routines for measuring a signal on an analog input.
+ *
+ *  This contains the functions for computing the mean, RMS, peak-to-peak and the Goertzel
+ *  magnitude and phase of a fundamental and its harmonics over blocks of samples.
+ *
+ *  @author Mohammad Yasin Azimi, Scott Williams
+ *  @date 2016-10-31
+ */
+#ifndef ANALYZER_H
+#define ANALYZER_H
+
+// new types
+#include "types.h"
+
+// Packet command for analyzer control and results
+#define ANALYZER_COMMAND 0x5A
+// Number of Goertzel bins, the fundamental and its harmonics
+#define ANALYZER_NB_BINS 4
+// Longest block in samples
+#define ANALYZER_MAX_LENGTH 4096
+
+typedef enum
+{
+  ANALYZER_STATUS_CHECK = 0,
+  ANALYZER_CHANNEL      = 1,
+  ANALYZER_LENGTH       = 2,
+  ANALYZER_FUNDAMENTAL  = 3
+} TAnalyzerControl;
+
+// Identifies each result sent in reply to ANALYZER_STATUS_CHECK
+typedef enum
+{
+  ANALYZER_RESULT_MEAN         = 0x10,
+  ANALYZER_RESULT_RMS          = 0x11,
+  ANALYZER_RESULT_PEAK_TO_PEAK = 0x12,
+  ANALYZER_RESULT_THD          = 0x13,
+  ANALYZER_RESULT_BLOCKS       = 0x14,
+  ANALYZER_RESULT_AMPLITUDE    = 0x20,	/*!< Plus the bin number */
+  ANALYZER_RESULT_PHASE        = 0x30	/*!< Plus the bin number */
+} TAnalyzerResult;
+
+typedef struct
+{
+  int16_t mean;					/*!< The average of the block */
+  uint16_t rms;					/*!< The root mean square of the block */
+  uint16_t peakToPeak;				/*!< The difference between the largest and smallest sample */
+  uint16_t thd;					/*!< The harmonic distortion relative to the fundamental in 0.01% */
+  uint16_t nbBlocks;				/*!< The number of blocks measured, wrapping */
+  uint16_t amplitude[ANALYZER_NB_BINS];		/*!< The amplitude of the fundamental and each harmonic */
+  uint16_t phase[ANALYZER_NB_BINS];		/*!< The phase of each bin against the start of the block, in 1/65536 of a turn */
+} TAnalyzerResults;
+
+/*! @brief Sets up the analyzer before first use.
+ *
+ *  @return BOOL - TRUE if the analyzer was successfully initialized.
+ */
+BOOL Analyzer_Init(void);
+
+/*! @brief Configures the analyzer or sends the latest results.
+ *
+ *  @param control The analyzer control command.
+ *  @param data The data sent with the command.
+ *  @return BOOL - TRUE if the command was valid.
+ *  @note Changing the configuration restarts the current block.
+ */
+BOOL Analyzer_Control(const TAnalyzerControl control, const uint16union_t data);
+
+/*! @brief Adds the samples from one scan of the analog inputs to the current block.
+ *
+ *  @param samples is the array of raw samples, indexed by scan list entry.
+ *  @return void.
+ *  @note Called once per scan. The results are latched at the end of each block.
+ */
+void Analyzer_Put(const int16_t samples[]);
+
+/*! @brief Gets the results of the last complete block.
+ *
+ *  @param results is a pointer to where the results are copied.
+ *  @return void.
+ */
+void Analyzer_Get(TAnalyzerResults* const results);
+
+#endif
@@ -0,0 +1,260 @@
+/*! @file
+ *
+ *  @brief Routines for capturing analog samples into RAM and uploading them afterwards.
+ *
+ *  Implementation of functions for recording a burst of samples from one analog channel at the
+ *  full scan rate, optionally around a trigger event, and sending it to the PC once the capture
+ *  is complete.
+ *
+ *  @author Mohammad Yasin Azimi, Scott Williams
+ *  @date 2016-10-31
+ */
+/*!
+ * @addtogroup Capture_module Capture module documentation
+ * @{
+ */
+#include "capture.h"
+#include "analog.h"
+#include "packet.h"
+
+static int16_t Buffer[CAPTURE_BUFFER_SIZE];	/*!< The circular capture buffer, Length samples long */
+static uint16_t Length;				/*!< The number of samples requested */
+static uint16_t PutIndex;			/*!< The position of the next sample in the buffer */
+static uint16_t NbSamples;			/*!< The number of samples in the buffer, up to Length */
+static uint16_t PostLeft;			/*!< The post-trigger samples still to be captured */
+static uint8_t ChannelNb;			/*!< The scan list entry being captured */
+static TCaptureState volatile State;		/*!< The state of the capture */
+
+static TCaptureTrigger Trigger;			/*!< The trigger condition */
+static uint8_t SourceNb;			/*!< The scan list entry the trigger watches */
+static int16_t Level;				/*!< The trigger level, or the bottom of the window */
+static int16_t Upper;				/*!< The top of the trigger window */
+static uint16_t PreTrigger;			/*!< The samples kept from before the trigger */
+static int16_t LastSample;			/*!< The previous sample of the trigger source */
+static BOOL HaveLast;				/*!< TRUE once LastSample is valid */
+
+/*! @brief Checks whether a sample of the trigger source fires the trigger.
+ *
+ *  @param sample is the new sample of the trigger source.
+ *  @return BOOL - TRUE if the trigger condition is met.
+ */
+static BOOL Triggered(const int16_t sample)
+{
+  BOOL fired;
+
+  switch (Trigger)
+  {
+    case CAPTURE_TRIGGER_LEVEL:
+      fired = (sample >= Level);
+      break;
+    case CAPTURE_TRIGGER_RISING:
+      fired = HaveLast && (LastSample < Level) && (sample >= Level);
+      break;
+    case CAPTURE_TRIGGER_FALLING:
+      fired = HaveLast && (LastSample >= Level) && (sample < Level);
+      break;
+    case CAPTURE_TRIGGER_WINDOW:
+      fired = (sample < Level) || (sample > Upper);
+      break;
+    default:
+      fired = bTRUE;
+      break;
+  }
+
+  LastSample = sample;
+  HaveLast = bTRUE;
+
+  return fired;
+}
+
+/*! @brief Sets up the capture buffer before first use.
+ *
+ *  @return BOOL - TRUE if the capture module was successfully initialized.
+ */
+BOOL Capture_Init(void)
+{
+  Length = 0;
+  PutIndex = 0;
+  NbSamples = 0;
+  PostLeft = 0;
+  ChannelNb = 0;
+  State = CAPTURE_IDLE;
+
+  // Capture immediately until told otherwise
+  Trigger = CAPTURE_TRIGGER_IMMEDIATE;
+  SourceNb = 0;
+  Level = 0;
+  Upper = 0;
+  PreTrigger = 0;
+
+  return bTRUE;
+}
+
+/*! @brief Arms a capture of an analog channel.
+ *
+ *  Samples are recorded into a circular buffer until the trigger fires and the post-trigger
+ *  part of the capture has been filled.
+ *  @param channelNb is the scan list entry to capture.
+ *  @param length is the number of samples to capture (1 to CAPTURE_BUFFER_SIZE), including
+ *         the pre-trigger samples.
+ *  @return BOOL - TRUE if the capture was armed.
+ *  @note Any previous capture is discarded.
+ */
+BOOL Capture_Start(const uint8_t channelNb, const uint16_t length)
+{
+  if ((channelNb >= ANALOG_NB_INPUTS) || (length == 0) || (length > CAPTURE_BUFFER_SIZE) || (PreTrigger >= length))
+    return bFALSE;
+
+  // The scan must not see a half-written setup
+  State = CAPTURE_IDLE;
+
+  ChannelNb = channelNb;
+  Length = length;
+  PutIndex = 0;
+  NbSamples = 0;
+  PostLeft = length - PreTrigger;
+  HaveLast = bFALSE;
+
+  State = CAPTURE_ARMED;
+
+  return bTRUE;
+}
+
+/*! @brief Sets up the trigger used by the next capture.
+ *
+ *  @param control The trigger control command.
+ *  @param data The data sent with the command.
+ *  @return BOOL - TRUE if the command was valid.
+ *  @note The trigger can only be changed while no capture is armed or running.
+ */
+BOOL Capture_Control(const TCaptureControl control, const uint16union_t data)
+{
+  BOOL valid = bTRUE;
+
+  if ((control != CAPTURE_STATUS_CHECK) && ((State == CAPTURE_ARMED) || (State == CAPTURE_RUNNING)))
+    return bFALSE;
+
+  switch (control)
+  {
+    case CAPTURE_STATUS_CHECK:
+      Packet_Put(CAPTURE_TRIGGER_COMMAND, CAPTURE_STATUS_CHECK, (uint8_t)State, (uint8_t)Trigger);
+      break;
+    case CAPTURE_TRIGGER_TYPE:
+      valid = (data.l <= CAPTURE_TRIGGER_WINDOW);
+      if (!valid)
+	break;
+      Trigger = (TCaptureTrigger)data.l;
+      break;
+    case CAPTURE_TRIGGER_SOURCE:
+      valid = (data.l < ANALOG_NB_INPUTS);
+      if (!valid)
+	break;
+      SourceNb = (uint8_t)data.l;
+      break;
+    case CAPTURE_TRIGGER_LEVEL_CHANGE:
+      Level = (int16_t)data.l;
+      break;
+    case CAPTURE_TRIGGER_UPPER_CHANGE:
+      Upper = (int16_t)data.l;
+      break;
+    case CAPTURE_PRETRIGGER:
+      valid = (data.l < CAPTURE_BUFFER_SIZE);
+      if (!valid)
+	break;
+      PreTrigger = data.l;
+      break;
+    default:
+      valid = bFALSE;
+      break;
+  }
+
+  return valid;
+}
+
+/*! @brief Records the samples from one scan of the analog inputs.
+ *
+ *  @param samples is the array of raw samples, indexed by scan list entry.
+ *  @return void.
+ *  @note Called once per scan; does nothing unless a capture is armed or running.
+ *        The PC is sent a CAPTURE_NOTIFY packet when the capture completes.
+ */
+void Capture_Put(const int16_t samples[])
+{
+  uint16union_t length;
+
+  if ((State != CAPTURE_ARMED) && (State != CAPTURE_RUNNING))
+    return;
+
+  Buffer[PutIndex] = samples[ChannelNb];
+  PutIndex++;
+  if (PutIndex == Length)
+    PutIndex = 0;
+  if (NbSamples < Length)
+    NbSamples++;
+
+  // The trigger is only looked for once the pre-trigger history is full
+  if (State == CAPTURE_ARMED)
+  {
+    if (!Triggered(samples[SourceNb]) || (NbSamples <= PreTrigger))
+      return;
+    State = CAPTURE_RUNNING;
+  }
+
+  // The triggering sample is the first post-trigger sample
+  PostLeft--;
+  if (PostLeft == 0)
+  {
+    State = CAPTURE_COMPLETE;
+
+    length.l = NbSamples;
+    Packet_Put(CAPTURE_NOTIFY, ChannelNb, length.s.Lo, length.s.Hi);
+  }
+}
+
+/*! @brief Gets the state of the current capture.
+ *
+ *  @return TCaptureState - The state of the capture.
+ */
+TCaptureState Capture_State(void)
+{
+  return State;
+}
+
+/*! @brief Sends a completed capture to the PC.
+ *
+ *  A header packet carrying the channel and length is followed by one data packet per sample,
+ *  oldest first, carrying the low byte of its index and the sample itself.
+ *  @return BOOL - TRUE if a completed capture was sent.
+ *  @note Blocks until every packet has been queued for transmission.
+ */
+BOOL Capture_Upload(void)
+{
+  uint16union_t length;
+  int16union_t sample;
+  uint16_t getIndex;
+
+  if (State != CAPTURE_COMPLETE)
+    return bFALSE;
+
+  length.l = NbSamples;
+  Packet_Put(CAPTURE_UPLOAD_HEADER, ChannelNb, length.s.Lo, length.s.Hi);
+
+  // The oldest sample is the one the next write would have overwritten
+  getIndex = (NbSamples == Length) ? PutIndex : 0;
+
+  for (uint16_t index = 0; index < NbSamples; index++)
+  {
+    sample.l = Buffer[getIndex];
+    Packet_Put(CAPTURE_UPLOAD_DATA, (uint8_t)index, sample.s.Lo, sample.s.Hi);
+
+    getIndex++;
+    if (getIndex == Length)
+      getIndex = 0;
+  }
+
+  return bTRUE;
+}
+
+/*!
+ * @}
+ */
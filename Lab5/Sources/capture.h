@@ -0,0 +1,107 @@
+/*! @file
+ *
+ *  @brief Routines for capturing analog samples into RAM and uploading them afterwards.
+ *
+ *  This contains the functions for recording a burst of samples from one analog channel at the
+ *  full scan rate, optionally around a trigger event, and sending it to the PC once the capture
+ *  is complete.
+ *
+ *  @author Mohammad Yasin Azimi, Scott Williams
+ *  @date 2016-10-31
+ */
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+// new types
+#include "types.h"
+
+// Number of samples held in the capture buffer
+#define CAPTURE_BUFFER_SIZE 4096
+
+// Packet commands used for the upload
+#define CAPTURE_UPLOAD_HEADER 0x54
+#define CAPTURE_UPLOAD_DATA   0x55
+// Packet command for trigger control
+#define CAPTURE_TRIGGER_COMMAND 0x56
+// Packet command sent when a capture completes
+#define CAPTURE_NOTIFY 0x57
+
+typedef enum
+{
+  CAPTURE_IDLE     = 0,
+  CAPTURE_ARMED    = 1,
+  CAPTURE_RUNNING  = 2,
+  CAPTURE_COMPLETE = 3
+} TCaptureState;
+
+typedef enum
+{
+  CAPTURE_TRIGGER_IMMEDIATE = 0,	/*!< Capture starts as soon as it is armed */
+  CAPTURE_TRIGGER_LEVEL     = 1,	/*!< Sample at or above the level */
+  CAPTURE_TRIGGER_RISING    = 2,	/*!< Sample crosses the level going up */
+  CAPTURE_TRIGGER_FALLING   = 3,	/*!< Sample crosses the level going down */
+  CAPTURE_TRIGGER_WINDOW    = 4		/*!< Sample leaves the window from the level to the upper level */
+} TCaptureTrigger;
+
+typedef enum
+{
+  CAPTURE_STATUS_CHECK   = 0,
+  CAPTURE_TRIGGER_TYPE   = 1,
+  CAPTURE_TRIGGER_SOURCE = 2,
+  CAPTURE_TRIGGER_LEVEL_CHANGE = 3,
+  CAPTURE_TRIGGER_UPPER_CHANGE = 4,
+  CAPTURE_PRETRIGGER     = 5
+} TCaptureControl;
+
+/*! @brief Sets up the capture buffer before first use.
+ *
+ *  @return BOOL - TRUE if the capture module was successfully initialized.
+ */
+BOOL Capture_Init(void);
+
+/*! @brief Arms a capture of an analog channel.
+ *
+ *  Samples are recorded into a circular buffer until the trigger fires and the post-trigger
+ *  part of the capture has been filled.
+ *  @param channelNb is the scan list entry to capture.
+ *  @param length is the number of samples to capture (1 to CAPTURE_BUFFER_SIZE), including
+ *         the pre-trigger samples.
+ *  @return BOOL - TRUE if the capture was armed.
+ *  @note Any previous capture is discarded.
+ */
+BOOL Capture_Start(const uint8_t channelNb, const uint16_t length);
+
+/*! @brief Sets up the trigger used by the next capture.
+ *
+ *  @param control The trigger control command.
+ *  @param data The data sent with the command.
+ *  @return BOOL - TRUE if the command was valid.
+ *  @note The trigger can only be changed while no capture is armed or running.
+ */
+BOOL Capture_Control(const TCaptureControl control, const uint16union_t data);
+
+/*! @brief Records the samples from one scan of the analog inputs.
+ *
+ *  @param samples is the array of raw samples, indexed by scan list entry.
+ *  @return void.
+ *  @note Called once per scan; does nothing unless a capture is armed or running.
+ *        The PC is sent a CAPTURE_NOTIFY packet when the capture completes.
+ */
+void Capture_Put(const int16_t samples[]);
+
+/*! @brief Gets the state of the current capture.
+ *
+ *  @return TCaptureState - The state of the capture.
+ */
+TCaptureState Capture_State(void);
+
+/*! @brief Sends a completed capture to the PC.
+ *
+ *  A header packet carrying the channel and length is followed by one data packet per sample,
+ *  oldest first, carrying the low byte of its index and the sample itself.
+ *  @return BOOL - TRUE if a completed capture was sent.
+ *  @note Blocks until every packet has been queued for transmission.
+ */
+BOOL Capture_Upload(void);
+
+#endif
@@ -0,0 +1,201 @@
+/*! @file
+ *
+ *  @brief Fixed-point fast Fourier transform.
+ *
+ *  Implementation of functions for an in-place Q15 radix-2 FFT with precomputed twiddle factors,
+ *  a Hann window and magnitude spectra.
+ *
+ *  @author Mohammad Yasin Azimi, Scott Williams
+ *  @date 2016-10-31
+ */
+/*!
+ * @addtogroup FFT_module FFT module documentation
+ * @{
+ */
+#include "fft.h"
+
+// sin(2.pi.k/FFT_MAX_SIZE) in Q15 for three quarters of a turn, so cos(x) = sin(x + quarter turn)
+static const int16_t Sine[FFT_MAX_SIZE * 3 / 4] =
+{
+  0, 402, 804, 1206, 1608, 2009, 2411, 2811, 3212, 3612, 4011, 4410,
+  4808, 5205, 5602, 5998, 6393, 6787, 7180, 7571, 7962, 8351, 8740, 9127,
+  9512, 9896, 10279, 10660, 11039, 11417, 11793, 12167, 12540, 12910, 13279, 13646,
+  14010, 14373, 14733, 15091, 15447, 15800, 16151, 16500, 16846, 17190, 17531, 17869,
+  18205, 18538, 18868, 19195, 19520, 19841, 20160, 20475, 20788, 21097, 21403, 21706,
+  22006, 22302, 22595, 22884, 23170, 23453, 23732, 24008, 24279, 24548, 24812, 25073,
+  25330, 25583, 25833, 26078, 26320, 26557, 26791, 27020, 27246, 27467, 27684, 27897,
+  28106, 28311, 28511, 28707, 28899, 29086, 29269, 29448, 29622, 29792, 29957, 30118,
+  30274, 30425, 30572, 30715, 30853, 30986, 31114, 31238, 31357, 31471, 31581, 31686,
+  31786, 31881, 31972, 32058, 32138, 32214, 32286, 32352, 32413, 32470, 32522, 32568,
+  32610, 32647, 32679, 32706, 32729, 32746, 32758, 32766, 32767, 32766, 32758, 32746,
+  32729, 32706, 32679, 32647, 32610, 32568, 32522, 32470, 32413, 32352, 32286, 32214,
+  32138, 32058, 31972, 31881, 31786, 31686, 31581, 31471, 31357, 31238, 31114, 30986,
+  30853, 30715, 30572, 30425, 30274, 30118, 29957, 29792, 29622, 29448, 29269, 29086,
+  28899, 28707, 28511, 28311, 28106, 27897, 27684, 27467, 27246, 27020, 26791, 26557,
+  26320, 26078, 25833, 25583, 25330, 25073, 24812, 24548, 24279, 24008, 23732, 23453,
+  23170, 22884, 22595, 22302, 22006, 21706, 21403, 21097, 20788, 20475, 20160, 19841,
+  19520, 19195, 18868, 18538, 18205, 17869, 17531, 17190, 16846, 16500, 16151, 15800,
+  15447, 15091, 14733, 14373, 14010, 13646, 13279, 12910, 12540, 12167, 11793, 11417,
+  11039, 10660, 10279, 9896, 9512, 9127, 8740, 8351, 7962, 7571, 7180, 6787,
+  6393, 5998, 5602, 5205, 4808, 4410, 4011, 3612, 3212, 2811, 2411, 2009,
+  1608, 1206, 804, 402, 0, -402, -804, -1206, -1608, -2009, -2411, -2811,
+  -3212, -3612, -4011, -4410, -4808, -5205, -5602, -5998, -6393, -6787, -7180, -7571,
+  -7962, -8351, -8740, -9127, -9512, -9896, -10279, -10660, -11039, -11417, -11793, -12167,
+  -12540, -12910, -13279, -13646, -14010, -14373, -14733, -15091, -15447, -15800, -16151, -16500,
+  -16846, -17190, -17531, -17869, -18205, -18538, -18868, -19195, -19520, -19841, -20160, -20475,
+  -20788, -21097, -21403, -21706, -22006, -22302, -22595, -22884, -23170, -23453, -23732, -24008,
+  -24279, -24548, -24812, -25073, -25330, -25583, -25833, -26078, -26320, -26557, -26791, -27020,
+  -27246, -27467, -27684, -27897, -28106, -28311, -28511, -28707, -28899, -29086, -29269, -29448,
+  -29622, -29792, -29957, -30118, -30274, -30425, -30572, -30715, -30853, -30986, -31114, -31238,
+  -31357, -31471, -31581, -31686, -31786, -31881, -31972, -32058, -32138, -32214, -32286, -32352,
+  -32413, -32470, -32522, -32568, -32610, -32647, -32679, -32706, -32729, -32746, -32758, -32766
+};
+
+// First half of a periodic Hann window of FFT_MAX_SIZE points in Q15, the second half mirrors it
+static const int16_t Hann[FFT_MAX_SIZE / 2 + 1] =
+{
+  0, 1, 5, 11, 20, 31, 44, 60, 79, 100, 123, 149,
+  177, 208, 241, 277, 315, 355, 398, 443, 491, 541, 593, 648,
+  705, 765, 827, 891, 958, 1027, 1098, 1171, 1247, 1325, 1406, 1488,
+  1573, 1660, 1749, 1841, 1935, 2030, 2128, 2229, 2331, 2435, 2542, 2651,
+  2761, 2874, 2989, 3105, 3224, 3345, 3468, 3592, 3719, 3847, 3978, 4110,
+  4244, 4380, 4518, 4657, 4799, 4942, 5087, 5233, 5381, 5531, 5682, 5835,
+  5990, 6146, 6304, 6463, 6624, 6786, 6950, 7115, 7282, 7449, 7619, 7789,
+  7961, 8134, 8308, 8484, 8661, 8839, 9018, 9198, 9379, 9561, 9745, 9929,
+  10114, 10300, 10487, 10676, 10864, 11054, 11245, 11436, 11628, 11821, 12014, 12208,
+  12403, 12598, 12794, 12991, 13188, 13385, 13583, 13781, 13980, 14179, 14378, 14578,
+  14778, 14978, 15179, 15379, 15580, 15781, 15982, 16183, 16384, 16585, 16786, 16987,
+  17188, 17389, 17589, 17790, 17990, 18190, 18390, 18589, 18788, 18987, 19185, 19383,
+  19580, 19777, 19974, 20170, 20365, 20560, 20754, 20947, 21140, 21332, 21523, 21714,
+  21904, 22092, 22281, 22468, 22654, 22839, 23023, 23207, 23389, 23570, 23750, 23929,
+  24107, 24284, 24460, 24634, 24807, 24979, 25149, 25319, 25486, 25653, 25818, 25982,
+  26144, 26305, 26464, 26622, 26778, 26933, 27086, 27237, 27387, 27535, 27681, 27826,
+  27969, 28111, 28250, 28388, 28524, 28658, 28790, 28921, 29049, 29176, 29300, 29423,
+  29544, 29663, 29779, 29894, 30007, 30117, 30226, 30333, 30437, 30539, 30640, 30738,
+  30833, 30927, 31019, 31108, 31195, 31280, 31362, 31443, 31521, 31597, 31670, 31741,
+  31810, 31877, 31941, 32003, 32063, 32120, 32175, 32227, 32277, 32325, 32370, 32413,
+  32453, 32491, 32527, 32560, 32591, 32619, 32645, 32668, 32689, 32708, 32724, 32737,
+  32748, 32757, 32763, 32767, 32767
+};
+
+/*! @brief Applies a Hann window to a block of samples.
+ *
+ *  @param data is the block of samples, windowed in place.
+ *  @param log2Size is the block length as a power of two.
+ *  @return void.
+ */
+void FFT_Window(int16_t data[], const uint8_t log2Size)
+{
+  uint16_t size = 1 << log2Size;
+  uint8_t stride = FFT_MAX_LOG2_SIZE - log2Size;
+  uint16_t index;
+
+  for (uint16_t n = 0; n < size; n++)
+  {
+    index = n << stride;
+    if (index > FFT_MAX_SIZE / 2)
+      index = FFT_MAX_SIZE - index;
+    data[n] = (int16_t)(((int32_t)data[n] * Hann[index]) >> 15);
+  }
+}
+
+/*! @brief In-place radix-2 decimation-in-time FFT in Q15.
+ *
+ *  Each stage halves its outputs so that nothing overflows, which scales the result by 1/N.
+ *  @param real is the real part, replaced by the real part of the spectrum.
+ *  @param imaginary is the imaginary part, replaced by the imaginary part of the spectrum.
+ *  @param log2Size is the transform length as a power of two.
+ *  @return void.
+ */
+void FFT_Transform(int16_t real[], int16_t imaginary[], const uint8_t log2Size)
+{
+  uint16_t size = 1 << log2Size;
+  uint16_t reversed = 0, bit;
+  int16_t swap;
+
+  // Bit-reversed reordering
+  for (uint16_t n = 1; n < size; n++)
+  {
+    bit = size >> 1;
+    while (reversed & bit)
+    {
+      reversed ^= bit;
+      bit >>= 1;
+    }
+    reversed |= bit;
+
+    if (n < reversed)
+    {
+      swap = real[n];
+      real[n] = real[reversed];
+      real[reversed] = swap;
+      swap = imaginary[n];
+      imaginary[n] = imaginary[reversed];
+      imaginary[reversed] = swap;
+    }
+  }
+
+  for (uint16_t half = 1, stride = FFT_MAX_SIZE >> 1; half < size; half <<= 1, stride >>= 1)
+  {
+    for (uint16_t k = 0; k < half; k++)
+    {
+      // W = cos(2.pi.k/2half) - j.sin(2.pi.k/2half)
+      int32_t cosine = Sine[k * stride + FFT_MAX_SIZE / 4];
+      int32_t sine = Sine[k * stride];
+
+      for (uint16_t top = k; top < size; top += half << 1)
+      {
+        uint16_t bottom = top + half;
+        int32_t tr = (real[bottom] * cosine + imaginary[bottom] * sine) >> 15;
+        int32_t ti = (imaginary[bottom] * cosine - real[bottom] * sine) >> 15;
+
+        real[bottom] = (int16_t)((real[top] - tr) >> 1);
+        imaginary[bottom] = (int16_t)((imaginary[top] - ti) >> 1);
+        real[top] = (int16_t)((real[top] + tr) >> 1);
+        imaginary[top] = (int16_t)((imaginary[top] + ti) >> 1);
+      }
+    }
+  }
+}
+
+/*! @brief Works out the magnitude of the lower half of a spectrum.
+ *
+ *  @param real is the real part of the spectrum.
+ *  @param imaginary is the imaginary part of the spectrum.
+ *  @param magnitude is where the N/2 magnitudes are stored.
+ *  @param log2Size is the transform length as a power of two.
+ *  @return void.
+ */
+void FFT_Magnitude(const int16_t real[], const int16_t imaginary[], uint16_t magnitude[], const uint8_t log2Size)
+{
+  uint16_t size = 1 << log2Size;
+  uint32_t value, root, bit;
+
+  for (uint16_t n = 0; n < size / 2; n++)
+  {
+    value = (uint32_t)((int32_t)real[n] * real[n]) + (uint32_t)((int32_t)imaginary[n] * imaginary[n]);
+
+    // Integer square root
+    root = 0;
+    bit = (uint32_t)1 << 30;
+    while (bit > value)
+      bit >>= 2;
+    while (bit != 0)
+    {
+      if (value >= root + bit)
+      {
+        value -= root + bit;
+        root = (root >> 1) + bit;
+      }
+      else
+        root >>= 1;
+      bit >>= 2;
+    }
+
+    magnitude[n] = (uint16_t)root;
+  }
+}
+
+/*!
+ * @}
+ */
@@ -0,0 +1,50 @@
+/*! @file
+ *
+ *  @brief Fixed-point fast Fourier transform.
+ *
+ *  This contains the functions for an in-place Q15 radix-2 FFT with precomputed twiddle factors,
+ *  a Hann window and magnitude spectra.
+ *
+ *  @author Mohammad Yasin Azimi, Scott Williams
+ *  @date 2016-10-31
+ */
+#ifndef FFT_H
+#define FFT_H
+
+// new types
+#include "types.h"
+
+// Smallest and largest transform sizes as powers of two
+#define FFT_MIN_LOG2_SIZE 4
+#define FFT_MAX_LOG2_SIZE 9
+#define FFT_MAX_SIZE (1 << FFT_MAX_LOG2_SIZE)
+
+/*! @brief Applies a Hann window to a block of samples.
+ *
+ *  @param data is the block of samples, windowed in place.
+ *  @param log2Size is the block length as a power of two.
+ *  @return void.
+ */
+void FFT_Window(int16_t data[], const uint8_t log2Size);
+
+/*! @brief In-place radix-2 decimation-in-time FFT in Q15.
+ *
+ *  Each stage halves its outputs so that nothing overflows, which scales the result by 1/N.
+ *  @param real is the real part, replaced by the real part of the spectrum.
+ *  @param imaginary is the imaginary part, replaced by the imaginary part of the spectrum.
+ *  @param log2Size is the transform length as a power of two.
+ *  @return void.
+ */
+void FFT_Transform(int16_t real[], int16_t imaginary[], const uint8_t log2Size);
+
+/*! @brief Works out the magnitude of the lower half of a spectrum.
+ *
+ *  @param real is the real part of the spectrum.
+ *  @param imaginary is the imaginary part of the spectrum.
+ *  @param magnitude is where the N/2 magnitudes are stored.
+ *  @param log2Size is the transform length as a power of two.
+ *  @return void.
+ */
+void FFT_Magnitude(const int16_t real[], const int16_t imaginary[], uint16_t magnitude[], const uint8_t log2Size);
+
+#endif
@@ -0,0 +1,88 @@
+/*! @file
+ *
+ *  @brief Input filters.
+ *
+ *  Implementation of functions for moving average, exponential (IIR) and decimating CIC filters on half-word-sized data.
+ *
+ *  @author Mohammad Yasin Azimi, Scott Williams
+ *  @date 2016-10-31
+ */
+/*!
+ * @addtogroup Filter_module Filter module documentation
+ * @{
+ */
+#include "filter.h"
+
+/*! @brief Moving average of a sliding window in constant time.
+ *
+ *  @param filter is the running sum of the window.
+ *  @param size is the length of the window.
+ *  @param oldValue is the sample leaving the window.
+ *  @param newValue is the sample entering the window.
+ *  @return int16_t - The average of the updated window.
+ */
+int16_t Filter_Average(TAverageFilter* const filter, const uint32_t size, const int16_t oldValue, const int16_t newValue)
+{
+  // Only the samples entering and leaving the window change the sum
+  filter->sum += (int32_t)newValue - (int32_t)oldValue;
+
+  return (int16_t)(filter->sum / (int32_t)size);
+}
+
+/*! @brief First-order IIR (exponential smoothing) filter in Q15.
+ *
+ *  @param filter is the filter state.
+ *  @param newValue is the new sample.
+ *  @return int16_t - The smoothed output.
+ */
+int16_t Filter_IIR(TIIRFilter* const filter, const int16_t newValue)
+{
+  int32_t error;
+
+  // y += alpha * (x - y), with x and y in Q15
+  error = ((int32_t)newValue << 15) - filter->output;
+  filter->output += (int32_t)(((int64_t)error * filter->alpha) >> 15);
+
+  return (int16_t)(filter->output >> 15);
+}
+
+/*! @brief Decimating cascaded integrator-comb filter.
+ *
+ *  @param filter is the filter state.
+ *  @param newValue is the new sample.
+ *  @param outputPtr points to where the output is stored once per decimation period.
+ *  @return BOOL - TRUE if a new output was produced.
+ */
+BOOL Filter_CIC(TCICFilter* const filter, const int16_t newValue, int16_t* const outputPtr)
+{
+  uint32_t value = (uint32_t)(int32_t)newValue;
+
+  // Integrators run at the input rate, their wrap-around cancels in the combs
+  for (uint8_t stage = 0; stage < FILTER_CIC_ORDER; stage++)
+  {
+    filter->integrators[stage] += value;
+    value = filter->integrators[stage];
+  }
+
+  filter->count++;
+  if (filter->count < (1 << filter->log2Rate))
+    return bFALSE;
+  filter->count = 0;
+
+  // Combs run at the decimated rate
+  for (uint8_t stage = 0; stage < FILTER_CIC_ORDER; stage++)
+  {
+    uint32_t previous = filter->combs[stage];
+    filter->combs[stage] = value;
+    value -= previous;
+  }
+
+  // Remove the filter gain of rate^order
+  *outputPtr = (int16_t)((int32_t)value >> (FILTER_CIC_ORDER * filter->log2Rate));
+
+  return bTRUE;
+}
+
+/*!
+ * @}
+ */
@@ -0,0 +1,67 @@
+/*! @file
+ *
+ *  @brief Input filters.
+ *
+ *  This contains the functions for moving average, exponential (IIR) and decimating CIC filters on half-word-sized data.
+ *
+ *  @author Mohammad Yasin Azimi, Scott Williams
+ *  @date 2016-10-31
+ */
+#ifndef FILTER_H
+#define FILTER_H
+
+// New types
+#include "types.h"
+
+// Number of integrator and comb stages in the CIC filter
+#define FILTER_CIC_ORDER 3
+// Largest CIC decimation rate as a power of two (a gain of 2^12 still fits in 32 bits)
+#define FILTER_CIC_MAX_LOG2_RATE 4
+
+typedef struct
+{
+  int32_t sum;                                 /*!< The running sum of the sliding window. */
+} TAverageFilter;
+
+typedef struct
+{
+  int32_t output;                              /*!< The filter output in Q15. */
+  uint16_t alpha;                              /*!< The smoothing factor in Q15, larger is faster. */
+} TIIRFilter;
+
+typedef struct
+{
+  uint32_t integrators[FILTER_CIC_ORDER];      /*!< The integrator stages, allowed to wrap. */
+  uint32_t combs[FILTER_CIC_ORDER];            /*!< The previous input of each comb stage. */
+  uint8_t count;                               /*!< The samples since the last output. */
+  uint8_t log2Rate;                            /*!< The decimation rate as a power of two. */
+} TCICFilter;
+
+/*! @brief Moving average of a sliding window in constant time.
+ *
+ *  @param filter is the running sum of the window.
+ *  @param size is the length of the window.
+ *  @param oldValue is the sample leaving the window.
+ *  @param newValue is the sample entering the window.
+ *  @return int16_t - The average of the updated window.
+ */
+int16_t Filter_Average(TAverageFilter* const filter, const uint32_t size, const int16_t oldValue, const int16_t newValue);
+
+/*! @brief First-order IIR (exponential smoothing) filter in Q15.
+ *
+ *  @param filter is the filter state.
+ *  @param newValue is the new sample.
+ *  @return int16_t - The smoothed output.
+ */
+int16_t Filter_IIR(TIIRFilter* const filter, const int16_t newValue);
+
+/*! @brief Decimating cascaded integrator-comb filter.
+ *
+ *  @param filter is the filter state.
+ *  @param newValue is the new sample.
+ *  @param outputPtr points to where the output is stored once per decimation period.
+ *  @return BOOL - TRUE if a new output was produced.
+ */
+BOOL Filter_CIC(TCICFilter* const filter, const int16_t newValue, int16_t* const outputPtr);
+
+#endif
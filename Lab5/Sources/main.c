@@ -37,6 +37,9 @@
 #include "SPI.h"
 #include "analog.h"
 #include "median.h"
+#include "capture.h"
+#include "analyzer.h"
+#include "spectrum.h"
 
 // Arbitrary thread stack size
 #define THREAD_STACK_SIZE   100
@@ -51,6 +54,11 @@
 #define CMD_REAL_TIME_CLOCK 0x0C
 #define CMD_PROTOCOL_MODE   0x0A
 #define CMD_ANALOG_INPUT    0x50
+#define CMD_ANALOG_FILTER   0x51
+#define CMD_ANALOG_SCAN     0x52
+#define CMD_CAPTURE_START   0x53
+#define CMD_ANALOG_REPORT   0x58
+#define CMD_ANALOG_STATS    0x59
 
 // Function Prototypes
 static void PITThread(void *arg);
@@ -66,6 +74,14 @@ static BOOL HandleTowerVersionPacket(void);
 static BOOL HandleTowerNumberPacket(void);
 static BOOL HandleTowerModePacket(void);
 static BOOL HandleProgramBytePacket(void);
+static BOOL HandleAnalogFilterPacket(void);
+static BOOL HandleAnalogScanPacket(void);
+static BOOL HandleCaptureStartPacket(void);
+static BOOL HandleCaptureTriggerPacket(void);
+static BOOL HandleAnalogReportPacket(void);
+static BOOL HandleAnalogStatsPacket(void);
+static BOOL HandleAnalyzerPacket(void);
+static BOOL HandleSpectrumPacket(void);
 
 static const uint32_t PITPeriod     = 500000000;  	/*!< PIT timer */
 static const uint16_t TowerNumber   = 0xDA2;      	/*!< Student ID */
@@ -85,6 +101,7 @@ static uint32_t DACThreadStack[THREAD_STACK_SIZE] 	__attribute__ ((aligned(0x08)
 static uint32_t TxThreadStack[THREAD_STACK_SIZE] 	__attribute__ ((aligned(0x08)));	/*!< The stack for the UART transmit thread */
 static uint32_t RxThreadStack[THREAD_STACK_SIZE] 	__attribute__ ((aligned(0x08)));	/*!< The stack for the UART recieve thread */
 static uint32_t FTMThreadStack[THREAD_STACK_SIZE] 	__attribute__ ((aligned(0x08)));	/*!< The stack for the UART recieve thread */
+static uint32_t SpectrumThreadStack[THREAD_STACK_SIZE] 	__attribute__ ((aligned(0x08)));	/*!< The stack for the spectrum thread */
 
 // ----------------------------------------
 // Global Semaphores
@@ -231,6 +248,108 @@ static void HandleProtocolModePacket()
   Packet_Put(CMD_PROTOCOL_MODE, 1, Current_Mode, 0);
 }
 
+/*! @brief Selects the filter applied to an analog input channel
+ *
+ *  @return BOOL - bTRUE if the channel, filter and parameter were valid.
+ */
+static BOOL HandleAnalogFilterPacket(void)
+{
+  return Analog_SetFilter(Packet_Parameter1, (TAnalogFilter)Packet_Parameter2, Packet_Parameter3);
+}
+
+/*! @brief Sets an entry of the analog scan list
+ *
+ *  Parameter 1 is the entry, parameter 2 the LTC1859 input and parameter 3 the span,
+ *  with bit 7 set for a differential pair.
+ *  @return BOOL - bTRUE if the entry was set.
+ */
+static BOOL HandleAnalogScanPacket(void)
+{
+  return Analog_SetScan(Packet_Parameter1, Packet_Parameter2, (TAnalogSpan)(Packet_Parameter3 & 0x7F),
+			(Packet_Parameter3 & 0x80) ? ANALOG_MODE_DIFFERENTIAL : ANALOG_MODE_SINGLE_ENDED);
+}
+
+/*! @brief Starts capturing an analog channel into RAM
+ *
+ *  Parameter 1 is the scan list entry and parameters 2 and 3 the number of samples.
+ *  @return BOOL - bTRUE if the capture was started.
+ */
+static BOOL HandleCaptureStartPacket(void)
+{
+  return Capture_Start(Packet_Parameter1, Packet_Parameter23);
+}
+
+/*! @brief Sets up the trigger of the next capture
+ *
+ *  Parameter 1 is the trigger control and parameters 2 and 3 its data.
+ *  @return BOOL - bTRUE if the control was valid.
+ */
+static BOOL HandleCaptureTriggerPacket(void)
+{
+  uint16union_t data;
+
+  data.l = Packet_Parameter23;
+  return Capture_Control((TCaptureControl)Packet_Parameter1, data);
+}
+
+/*! @brief Sets the deadband and minimum report interval of an analog channel
+ *
+ *  Parameter 1 is the scan list entry, parameter 2 the deadband and parameter 3 the
+ *  minimum number of scans between reports.
+ *  @return BOOL - bTRUE if the channel was valid.
+ */
+static BOOL HandleAnalogReportPacket(void)
+{
+  return Analog_SetReport(Packet_Parameter1, Packet_Parameter2, Packet_Parameter3);
+}
+
+/*! @brief Sends the asynchronous report statistics of an analog channel
+ *
+ *  The number of scans where the value changed is sent first, followed by the number of
+ *  reports actually sent with bit 7 of the channel set.
+ *  @return BOOL - bTRUE if the channel was valid.
+ */
+static BOOL HandleAnalogStatsPacket(void)
+{
+  uint8_t channelNb = Packet_Parameter1;
+  uint16union_t count;
+
+  if (channelNb >= ANALOG_NB_INPUTS)
+    return bFALSE;
+
+  count.l = Analog_Input.nbChanges[channelNb];
+  Packet_Put(CMD_ANALOG_STATS, channelNb, count.s.Lo, count.s.Hi);
+  count.l = Analog_Input.nbReports[channelNb];
+  Packet_Put(CMD_ANALOG_STATS, channelNb | 0x80, count.s.Lo, count.s.Hi);
+  return bTRUE;
+}
+
+/*! @brief Configures the analyzer or sends its results
+ *
+ *  Parameter 1 is the analyzer control and parameters 2 and 3 its data.
+ *  @return BOOL - bTRUE if the control was valid.
+ */
+static BOOL HandleAnalyzerPacket(void)
+{
+  uint16union_t data;
+
+  data.l = Packet_Parameter23;
+  return Analyzer_Control((TAnalyzerControl)Packet_Parameter1, data);
+}
+
+/*! @brief Configures, starts or stops the spectra
+ *
+ *  Parameter 1 is the spectrum control and parameters 2 and 3 its data.
+ *  @return BOOL - bTRUE if the control was valid.
+ */
+static BOOL HandleSpectrumPacket(void)
+{
+  uint16union_t data;
+
+  data.l = Packet_Parameter23;
+  return Spectrum_Control((TSpectrumControl)Packet_Parameter1, data);
+}
+
 /*! @brief FTM callback function to turn off blue LED
  *
  *  @return void.
@@ -311,28 +430,34 @@ static void DACThread(void* arg)
     // Start FTM channel1 timer
     (void)FTM_StartTimer(&FTMChannel1);
 
-    for (uint8_t channelNb = 0; channelNb < ANALOG_NB_INPUTS; channelNb++)
-      Analog_Get(channelNb);
+    Analog_Scan();
+    Capture_Put(Analog_Input.sample);
+    Analyzer_Put(Analog_Input.sample);
+    Spectrum_Put(Analog_Input.sample);
+
+    // Samples are not streamed while a capture is armed or running, the PC fetches the capture instead
+    if ((Capture_State() == CAPTURE_ARMED) || (Capture_State() == CAPTURE_RUNNING))
+      continue;
 
     // This handles the asynchronous mode
     if (Current_Mode == 0)
     {
-      for (uint8_t channelNb = 0; channelNb < ANALOG_NB_INPUTS; channelNb++)
+      for (uint8_t channelNb = 0; channelNb < Analog_Input.nbChannels; channelNb++)
       {
-	// Transmit packet with changes in the value
-	if (Analog_Input[channelNb].value.l != Analog_Input[channelNb].oldValue.l)
+	// Transmit packet with changes in the value beyond the deadband
+	if (Analog_ReportDue(channelNb))
 	{
-	  Packet_Put(CMD_ANALOG_INPUT, channelNb, Analog_Input[channelNb].value.s.Lo, Analog_Input[channelNb].value.s.Hi);
+	  Packet_Put(CMD_ANALOG_INPUT, channelNb, Analog_Input.value[channelNb].s.Lo, Analog_Input.value[channelNb].s.Hi);
 	}
       }
     }
     // This handles the synchronous mode
     else if (Current_Mode == 1)
     {
-      for (uint8_t channelNb = 0; channelNb < ANALOG_NB_INPUTS; channelNb++)
+      for (uint8_t channelNb = 0; channelNb < Analog_Input.nbChannels; channelNb++)
       {
 	// Transmit all packets
-	Packet_Put(CMD_ANALOG_INPUT, channelNb, Analog_Input[channelNb].value.s.Lo, Analog_Input[channelNb].value.s.Hi);
+	Packet_Put(CMD_ANALOG_INPUT, channelNb, Analog_Input.value[channelNb].s.Lo, Analog_Input.value[channelNb].s.Hi);
       }
     }
   }
@@ -394,6 +519,33 @@ static void PacketThread(void* arg)
 	  HandleProtocolModePacket();
 	  success = bTRUE;
 	  break;
+	case CMD_ANALOG_FILTER:
+	  success = HandleAnalogFilterPacket();
+	  break;
+	case CMD_ANALOG_SCAN:
+	  success = HandleAnalogScanPacket();
+	  break;
+	case CMD_CAPTURE_START:
+	  success = HandleCaptureStartPacket();
+	  break;
+	case CAPTURE_UPLOAD_HEADER:
+	  success = Capture_Upload();
+	  break;
+	case CAPTURE_TRIGGER_COMMAND:
+	  success = HandleCaptureTriggerPacket();
+	  break;
+	case CMD_ANALOG_REPORT:
+	  success = HandleAnalogReportPacket();
+	  break;
+	case CMD_ANALOG_STATS:
+	  success = HandleAnalogStatsPacket();
+	  break;
+	case ANALYZER_COMMAND:
+	  success = HandleAnalyzerPacket();
+	  break;
+	case SPECTRUM_COMMAND:
+	  success = HandleSpectrumPacket();
+	  break;
 	default:
 	  success = bFALSE;
 	  break;
@@ -429,7 +581,10 @@ static void InitThread(void* arg)
 	&& PIT_Init(CPU_BUS_CLK_HZ)
 	&& FTM_Init()
 	&& LEDs_Init()
-	&& Analog_Init(CPU_BUS_CLK_HZ))
+	&& Analog_Init(CPU_BUS_CLK_HZ)
+	&& Capture_Init()
+	&& Analyzer_Init()
+	&& Spectrum_Init())
     {
       // Allocates flash memory to NvTowerNumber and NvTowerMode
       Flash_AllocateVar((void*)&NvTowerNumber, sizeof(*NvTowerNumber));
@@ -517,6 +672,11 @@ int main(void)
 			  &PITThreadStack[THREAD_STACK_SIZE - 1],
 			  10);
 
+  error = OS_ThreadCreate(SpectrumThread,	// Spectrum thread
+			  NULL,
+			  &SpectrumThreadStack[THREAD_STACK_SIZE - 1],
+			  11); // Lowest application priority, sampling is never held up
+
   // Start multithreading - never returns!
   OS_Start();
 }
@@ -19,6 +19,16 @@
 void Partition(int16_t* arraY, int32_t sizE);
 void Quicksort(int16_t* arraY, int32_t sizE);
 
+// Branch-free compare-exchange, leaving the smaller value in a and the larger in b
+#define MEDIAN_SORT(a, b) \
+{ \
+  int32_t difference = (int32_t)(a) - (int32_t)(b); \
+  int32_t mask = difference >> 31; \
+  int16_t minimum = (b) + (difference & mask); \
+  (b) = (a) - (difference & mask); \
+  (a) = minimum; \
+}
+
 /*! @brief Median filters half-words.
  *
  *  @param array is an array half-words for which the median is sought.
@@ -53,6 +63,164 @@ int16_t Median_Filter(const int16_t array[], const uint32_t size)
   }
 }
 
+/*! @brief Replaces the oldest sample of a sorted sliding window and returns the new median.
+ *
+ *  The window is kept in ascending order, so each new sample costs a single
+ *  binary search and one pass of shifting rather than a full sort.
+ *  @param sorted is the sliding window in ascending order.
+ *  @param size is the length of the window.
+ *  @param oldValue is the sample leaving the window (it must be in sorted[]).
+ *  @param newValue is the sample entering the window.
+ *  @return int16_t - The median of the updated window.
+ */
+int16_t Median_Update(int16_t sorted[], const uint32_t size, const int16_t oldValue, const int16_t newValue)
+{
+  uint32_t lowerIndex = 0;
+  uint32_t upperIndex = size - 1;
+  uint32_t index;
+
+  // Binary search for the sample leaving the window
+  while (lowerIndex < upperIndex)
+  {
+    index = (lowerIndex + upperIndex) / 2;
+    if (sorted[index] < oldValue)
+      lowerIndex = index + 1;
+    else
+      upperIndex = index;
+  }
+  index = lowerIndex;
+
+  // Slide the neighbours into the gap until the new sample fits
+  if (newValue > oldValue)
+  {
+    while ((index + 1 < size) && (sorted[index + 1] < newValue))
+    {
+      sorted[index] = sorted[index + 1];
+      index++;
+    }
+  }
+  else
+  {
+    while ((index > 0) && (sorted[index - 1] > newValue))
+    {
+      sorted[index] = sorted[index - 1];
+      index--;
+    }
+  }
+  sorted[index] = newValue;
+
+  if ((size % 2) == 0)
+  {
+    // return average of middle values
+    return ((sorted[(size/2)-1])+(sorted[size/2]))/2;
+  }
+  else
+  {
+    // return middle value of sorted array of odd size, noted integer division
+    return sorted[(size/2)];
+  }
+}
+
+/*! @brief Median of 3 half-words using a fixed median network.
+ *
+ *  @param array is an array of 3 half-words for which the median is sought.
+ *  @return int16_t - The median, found with 3 branch-free compare-exchanges.
+ */
+int16_t Median_Network3(const int16_t array[])
+{
+  int16_t p[3];
+
+  for (uint32_t index = 0; index < 3; index++)
+    p[index] = array[index];
+
+  MEDIAN_SORT(p[0], p[1]); MEDIAN_SORT(p[1], p[2]); MEDIAN_SORT(p[0], p[1]);
+
+  return p[1];
+}
+
+/*! @brief Median of 5 half-words using a fixed median network.
+ *
+ *  @param array is an array of 5 half-words for which the median is sought.
+ *  @return int16_t - The median, found with 7 branch-free compare-exchanges.
+ */
+int16_t Median_Network5(const int16_t array[])
+{
+  int16_t p[5];
+
+  for (uint32_t index = 0; index < 5; index++)
+    p[index] = array[index];
+
+  MEDIAN_SORT(p[0], p[1]); MEDIAN_SORT(p[3], p[4]); MEDIAN_SORT(p[0], p[3]); MEDIAN_SORT(p[1], p[4]);
+  MEDIAN_SORT(p[1], p[2]); MEDIAN_SORT(p[2], p[3]); MEDIAN_SORT(p[1], p[2]);
+
+  return p[2];
+}
+
+/*! @brief Median of 7 half-words using a fixed median network.
+ *
+ *  @param array is an array of 7 half-words for which the median is sought.
+ *  @return int16_t - The median, found with 13 branch-free compare-exchanges.
+ */
+int16_t Median_Network7(const int16_t array[])
+{
+  int16_t p[7];
+
+  for (uint32_t index = 0; index < 7; index++)
+    p[index] = array[index];
+
+  MEDIAN_SORT(p[0], p[5]); MEDIAN_SORT(p[0], p[3]); MEDIAN_SORT(p[1], p[6]); MEDIAN_SORT(p[2], p[4]);
+  MEDIAN_SORT(p[0], p[1]); MEDIAN_SORT(p[3], p[5]); MEDIAN_SORT(p[2], p[6]); MEDIAN_SORT(p[2], p[3]);
+  MEDIAN_SORT(p[3], p[6]); MEDIAN_SORT(p[4], p[5]); MEDIAN_SORT(p[1], p[4]); MEDIAN_SORT(p[1], p[3]);
+  MEDIAN_SORT(p[3], p[4]);
+
+  return p[3];
+}
+
+/*! @brief Median of 9 half-words using a fixed median network.
+ *
+ *  @param array is an array of 9 half-words for which the median is sought.
+ *  @return int16_t - The median, found with 19 branch-free compare-exchanges.
+ */
+int16_t Median_Network9(const int16_t array[])
+{
+  int16_t p[9];
+
+  for (uint32_t index = 0; index < 9; index++)
+    p[index] = array[index];
+
+  MEDIAN_SORT(p[1], p[2]); MEDIAN_SORT(p[4], p[5]); MEDIAN_SORT(p[7], p[8]); MEDIAN_SORT(p[0], p[1]);
+  MEDIAN_SORT(p[3], p[4]); MEDIAN_SORT(p[6], p[7]); MEDIAN_SORT(p[1], p[2]); MEDIAN_SORT(p[4], p[5]);
+  MEDIAN_SORT(p[7], p[8]); MEDIAN_SORT(p[0], p[3]); MEDIAN_SORT(p[5], p[8]); MEDIAN_SORT(p[4], p[7]);
+  MEDIAN_SORT(p[3], p[6]); MEDIAN_SORT(p[1], p[4]); MEDIAN_SORT(p[2], p[5]); MEDIAN_SORT(p[4], p[7]);
+  MEDIAN_SORT(p[4], p[2]); MEDIAN_SORT(p[6], p[4]); MEDIAN_SORT(p[4], p[2]);
+
+  return p[4];
+}
+
+/*! @brief Median of 11 half-words using a fixed median network.
+ *
+ *  @param array is an array of 11 half-words for which the median is sought.
+ *  @return int16_t - The median, found with 32 branch-free compare-exchanges.
+ */
+int16_t Median_Network11(const int16_t array[])
+{
+  int16_t p[11];
+
+  for (uint32_t index = 0; index < 11; index++)
+    p[index] = array[index];
+
+  MEDIAN_SORT(p[0], p[1]); MEDIAN_SORT(p[2], p[3]); MEDIAN_SORT(p[4], p[5]); MEDIAN_SORT(p[6], p[7]);
+  MEDIAN_SORT(p[8], p[9]); MEDIAN_SORT(p[0], p[2]); MEDIAN_SORT(p[1], p[3]); MEDIAN_SORT(p[4], p[6]);
+  MEDIAN_SORT(p[5], p[7]); MEDIAN_SORT(p[8], p[10]); MEDIAN_SORT(p[1], p[2]); MEDIAN_SORT(p[5], p[6]);
+  MEDIAN_SORT(p[9], p[10]); MEDIAN_SORT(p[0], p[4]); MEDIAN_SORT(p[1], p[5]); MEDIAN_SORT(p[2], p[6]);
+  MEDIAN_SORT(p[3], p[7]); MEDIAN_SORT(p[2], p[4]); MEDIAN_SORT(p[3], p[5]); MEDIAN_SORT(p[1], p[2]);
+  MEDIAN_SORT(p[3], p[4]); MEDIAN_SORT(p[5], p[6]); MEDIAN_SORT(p[9], p[10]); MEDIAN_SORT(p[0], p[8]);
+  MEDIAN_SORT(p[1], p[9]); MEDIAN_SORT(p[2], p[10]); MEDIAN_SORT(p[4], p[8]); MEDIAN_SORT(p[5], p[9]);
+  MEDIAN_SORT(p[6], p[10]); MEDIAN_SORT(p[3], p[5]); MEDIAN_SORT(p[6], p[8]); MEDIAN_SORT(p[5], p[6]);
+
+  return p[5];
+}
+
 /*! @brief Partition array into sections
  *
  *  @param arraY is an array half-words for which the median is sought.
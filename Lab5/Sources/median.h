@@ -21,4 +21,51 @@
  */
 int16_t Median_Filter(const int16_t array[], const uint32_t size);
 
+/*! @brief Replaces the oldest sample of a sorted sliding window and returns the new median.
+ *
+ *  The window is kept in ascending order, so each new sample costs a single
+ *  binary search and one pass of shifting rather than a full sort.
+ *  @param sorted is the sliding window in ascending order.
+ *  @param size is the length of the window.
+ *  @param oldValue is the sample leaving the window (it must be in sorted[]).
+ *  @param newValue is the sample entering the window.
+ *  @return int16_t - The median of the updated window.
+ */
+int16_t Median_Update(int16_t sorted[], const uint32_t size, const int16_t oldValue, const int16_t newValue);
+
+/*! @brief Median of 3 half-words using a fixed median network.
+ *
+ *  @param array is an array of 3 half-words for which the median is sought.
+ *  @return int16_t - The median, found with 3 branch-free compare-exchanges.
+ */
+int16_t Median_Network3(const int16_t array[]);
+
+/*! @brief Median of 5 half-words using a fixed median network.
+ *
+ *  @param array is an array of 5 half-words for which the median is sought.
+ *  @return int16_t - The median, found with 7 branch-free compare-exchanges.
+ */
+int16_t Median_Network5(const int16_t array[]);
+
+/*! @brief Median of 7 half-words using a fixed median network.
+ *
+ *  @param array is an array of 7 half-words for which the median is sought.
+ *  @return int16_t - The median, found with 13 branch-free compare-exchanges.
+ */
+int16_t Median_Network7(const int16_t array[]);
+
+/*! @brief Median of 9 half-words using a fixed median network.
+ *
+ *  @param array is an array of 9 half-words for which the median is sought.
+ *  @return int16_t - The median, found with 19 branch-free compare-exchanges.
+ */
+int16_t Median_Network9(const int16_t array[]);
+
+/*! @brief Median of 11 half-words using a fixed median network.
+ *
+ *  @param array is an array of 11 half-words for which the median is sought.
+ *  @return int16_t - The median, found with 32 branch-free compare-exchanges.
+ */
+int16_t Median_Network11(const int16_t array[]);
+
 #endif
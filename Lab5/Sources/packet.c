@@ -12,6 +12,7 @@
  * @{
  */
 
+#include "crc.h"
 #include "UART.h"
 #include "LEDs.h"
 #include "packet.h"
@@ -32,7 +33,7 @@ BOOL Packet_Init(const uint32_t baudRate, const uint32_t moduleClk)
   // Packet semaphore created and set to 0
   PacketSemaphore = OS_SemaphoreCreate(0);
 
-  return UART_Init(baudRate, moduleClk);
+  return CRC_Init() && UART_Init(baudRate, moduleClk);
 }
 
 /*! @brief Attempts to get a packet from the received data.
@@ -119,6 +120,47 @@ void Packet_Put(const uint8_t command, const uint8_t parameter1, const uint8_t p
   OS_SemaphoreSignal(PacketPutSemaphore);
 }
 
+/*! @brief Builds an extended frame and places it in the transmit FIFO buffer.
+ *
+ *  @param type The frame's type.
+ *  @param payload The payload bytes.
+ *  @param length The number of payload bytes, 1 to PACKET_FRAME_MAX.
+ *  @return BOOL - TRUE if the frame was queued.
+ */
+BOOL Packet_PutFrame(const uint8_t type, const uint8_t payload[], const uint16_t length)
+{
+  uint16_t crc;
+
+  if ((length == 0) || (length > PACKET_FRAME_MAX))
+    return bFALSE;
+
+  // The whole frame goes out under the packet put semaphore, so packets never land inside it
+  OS_SemaphoreWait(PacketPutSemaphore, 0);
+
+  UART_OutChar(PACKET_FRAME_SYNC1);
+  UART_OutChar(PACKET_FRAME_SYNC2);
+
+  // The CRC covers the type, length and payload, and is found as they are sent
+  crc = CRC_Update(CRC_SEED, type);
+  UART_OutChar(type);
+  crc = CRC_Update(crc, (uint8_t)length);
+  UART_OutChar((uint8_t)length);
+  crc = CRC_Update(crc, (uint8_t)(length >> 8));
+  UART_OutChar((uint8_t)(length >> 8));
+  for (uint16_t byte = 0; byte < length; byte++)
+  {
+    crc = CRC_Update(crc, payload[byte]);
+    UART_OutChar(payload[byte]);
+  }
+
+  UART_OutChar((uint8_t)(crc >> 8));
+  UART_OutChar((uint8_t)crc);
+
+  OS_SemaphoreSignal(PacketPutSemaphore);
+
+  return bTRUE;
+}
+
 /*!
  * @}
  */
@@ -18,6 +18,14 @@
 // Packet structure
 #define PACKET_NB_BYTES 5
 
+// Extended frame structure: the sync bytes, type, length (LSB first), payload and CRC-16 (MSB first)
+#define PACKET_FRAME_SYNC1 0xA5
+#define PACKET_FRAME_SYNC2 0x5A
+#define PACKET_FRAME_HEADER 5
+#define PACKET_FRAME_OVERHEAD (PACKET_FRAME_HEADER + 2)
+// Maximum number of payload bytes in an extended frame
+#define PACKET_FRAME_MAX 256
+
 // Packet semaphores
 OS_ECB *PacketSemaphore;
 OS_ECB *PacketPutSemaphore;
@@ -89,4 +97,13 @@ BOOL Packet_Get(void);
  */
 void Packet_Put(const uint8_t command, const uint8_t parameter1, const uint8_t parameter2, const uint8_t parameter3);
 
+/*! @brief Builds an extended frame and places it in the transmit FIFO buffer.
+ *
+ *  @param type The frame's type.
+ *  @param payload The payload bytes.
+ *  @param length The number of payload bytes, 1 to PACKET_FRAME_MAX.
+ *  @return BOOL - TRUE if the frame was queued.
+ */
+BOOL Packet_PutFrame(const uint8_t type, const uint8_t payload[], const uint16_t length);
+
 #endif
@@ -0,0 +1,204 @@
+/*! @file
+ *
+ *  @brief Routines for sending magnitude spectra of an analog input.
+ *
+ *  Implementation of functions for collecting blocks of samples from an analog input and
+ *  transforming them in a low-priority thread into magnitude spectra for the PC.
+ *
+ *  @author Mohammad Yasin Azimi, Scott Williams
+ *  @date 2016-10-31
+ */
+/*!
+ * @addtogroup Spectrum_module Spectrum module documentation
+ * @{
+ */
+#include "spectrum.h"
+#include "fft.h"
+#include "analog.h"
+#include "packet.h"
+#include "MK70F12.h"
+
+static int16_t Block[2][FFT_MAX_SIZE];		/*!< One block being filled while the other is transformed */
+static int16_t Imaginary[FFT_MAX_SIZE];		/*!< The imaginary part of the transform */
+static uint16_t Magnitude[FFT_MAX_SIZE / 2];	/*!< The magnitude spectrum */
+
+static uint8_t ChannelNb;			/*!< The scan list entry being transformed */
+static uint8_t Log2Size;			/*!< The transform length as a power of two */
+static uint16_t NbSamples;			/*!< The samples in the block being filled */
+static uint8_t FillNb;				/*!< The block being filled */
+static uint8_t ReadyNb;				/*!< The block handed to the thread */
+static BOOL Continuous;				/*!< FALSE to stop after one block */
+static BOOL volatile Running;			/*!< TRUE while blocks are being collected */
+static BOOL volatile Busy;			/*!< TRUE while the thread has a block */
+static uint32_t Cycles;				/*!< The core cycles taken by the last transform */
+static uint16_t Dropped;			/*!< The blocks dropped because the thread was busy, wrapping */
+
+/*! @brief Sets up the spectrum module before first use.
+ *
+ *  @return BOOL - TRUE if the spectrum module was successfully initialized.
+ */
+BOOL Spectrum_Init(void)
+{
+  SpectrumSemaphore = OS_SemaphoreCreate(0);
+
+  ChannelNb = 0;
+  Log2Size = FFT_MAX_LOG2_SIZE;
+  NbSamples = 0;
+  FillNb = 0;
+  ReadyNb = 0;
+  Continuous = bFALSE;
+  Running = bFALSE;
+  Busy = bFALSE;
+  Cycles = 0;
+  Dropped = 0;
+
+  // Enable the DWT cycle counter (DEMCR TRCENA, DWT_CTRL CYCCNTENA)
+  DEMCR |= (1 << 24);
+  DWT_CTRL |= 1;
+
+  return bTRUE;
+}
+
+/*! @brief Configures, starts or stops the spectra, or sends the transform statistics.
+ *
+ *  @param control The spectrum control command.
+ *  @param data The data sent with the command; the size is a power of two and a start with
+ *         data 1 runs continuously rather than once.
+ *  @return BOOL - TRUE if the command was valid.
+ *  @note The channel and size can only be changed while stopped and idle.
+ */
+BOOL Spectrum_Control(const TSpectrumControl control, const uint16union_t data)
+{
+  uint16union_t value;
+  BOOL valid = bTRUE;
+
+  switch (control)
+  {
+    case SPECTRUM_STATUS_CHECK:
+      value.l = (uint16_t)Cycles;
+      Packet_Put(SPECTRUM_COMMAND, SPECTRUM_RESULT_CYCLES_LO, value.s.Lo, value.s.Hi);
+      value.l = (uint16_t)(Cycles >> 16);
+      Packet_Put(SPECTRUM_COMMAND, SPECTRUM_RESULT_CYCLES_HI, value.s.Lo, value.s.Hi);
+      value.l = Dropped;
+      Packet_Put(SPECTRUM_COMMAND, SPECTRUM_RESULT_DROPPED, value.s.Lo, value.s.Hi);
+      break;
+    case SPECTRUM_CHANNEL:
+      valid = !Running && !Busy && (data.l < ANALOG_NB_INPUTS);
+      if (!valid)
+	break;
+      ChannelNb = (uint8_t)data.l;
+      break;
+    case SPECTRUM_SIZE:
+      valid = !Running && !Busy && (data.l >= FFT_MIN_LOG2_SIZE) && (data.l <= FFT_MAX_LOG2_SIZE);
+      if (!valid)
+	break;
+      Log2Size = (uint8_t)data.l;
+      break;
+    case SPECTRUM_START:
+      valid = (data.l <= 1);
+      if (!valid)
+	break;
+      Running = bFALSE;
+      NbSamples = 0;
+      Continuous = (BOOL)data.l;
+      Running = bTRUE;
+      break;
+    case SPECTRUM_STOP:
+      Running = bFALSE;
+      break;
+    default:
+      valid = bFALSE;
+      break;
+  }
+
+  return valid;
+}
+
+/*! @brief Adds the samples from one scan of the analog inputs to the current block.
+ *
+ *  @param samples is the array of raw samples, indexed by scan list entry.
+ *  @return void.
+ *  @note Called once per scan. A full block is handed to the spectrum thread, or dropped if
+ *        the thread is still busy with the previous one.
+ */
+void Spectrum_Put(const int16_t samples[])
+{
+  if (!Running)
+    return;
+
+  Block[FillNb][NbSamples] = samples[ChannelNb];
+  NbSamples++;
+
+  if (NbSamples < ((uint16_t)1 << Log2Size))
+    return;
+
+  NbSamples = 0;
+
+  if (Busy)
+  {
+    Dropped++;
+    return;
+  }
+
+  ReadyNb = FillNb;
+  FillNb ^= 1;
+  Busy = bTRUE;
+  if (!Continuous)
+    Running = bFALSE;
+
+  OS_SemaphoreSignal(SpectrumSemaphore);
+}
+
+/*! @brief Spectrum thread.
+ *
+ *  Windows and transforms each block and sends the magnitude spectrum in extended frames of
+ *  up to SPECTRUM_FRAME_BINS bins.
+ *  @return void.
+ *  @note Runs at a low priority so that sampling is never held up.
+ */
+void SpectrumThread(void* arg)
+{
+  static uint8_t frame[SPECTRUM_FRAME_HEADER + 2 * SPECTRUM_FRAME_BINS];
+  uint32_t start;
+  uint16_t size, nbBins;
+
+  for (;;)
+  {
+    OS_SemaphoreWait(SpectrumSemaphore, 0);
+
+    size = (uint16_t)1 << Log2Size;
+    for (uint16_t n = 0; n < size; n++)
+      Imaginary[n] = 0;
+
+    start = DWT_CYCCNT;
+    FFT_Window(Block[ReadyNb], Log2Size);
+    FFT_Transform(Block[ReadyNb], Imaginary, Log2Size);
+    FFT_Magnitude(Block[ReadyNb], Imaginary, Magnitude, Log2Size);
+    Cycles = DWT_CYCCNT - start;
+
+    // The block can be refilled while the spectrum is sent
+    Busy = bFALSE;
+
+    // Each frame says where its bins go, so a frame lost on the link only loses its own bins
+    for (uint16_t first = 0; first < size / 2; first += nbBins)
+    {
+      nbBins = size / 2 - first;
+      if (nbBins > SPECTRUM_FRAME_BINS)
+	nbBins = SPECTRUM_FRAME_BINS;
+
+      frame[0] = ChannelNb;
+      frame[1] = Log2Size;
+      frame[2] = (uint8_t)first;
+      for (uint16_t bin = 0; bin < nbBins; bin++)
+      {
+	frame[SPECTRUM_FRAME_HEADER + 2 * bin] = (uint8_t)Magnitude[first + bin];
+	frame[SPECTRUM_FRAME_HEADER + 2 * bin + 1] = (uint8_t)(Magnitude[first + bin] >> 8);
+      }
+      (void)Packet_PutFrame(SPECTRUM_FRAME, frame, SPECTRUM_FRAME_HEADER + 2 * nbBins);
+    }
+  }
+}
+
+/*!
+ * @}
+ */
@@ -0,0 +1,81 @@
+/*! @file
+ *
+ *  @brief Routines for sending magnitude spectra of an analog input.
+ *
+ *  This contains the functions for collecting blocks of samples from an analog input and
+ *  transforming them in a low-priority thread into magnitude spectra for the PC.
+ *
+ *  @author Mohammad Yasin Azimi, Scott Williams
+ *  @date 2016-10-31
+ */
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+// new types
+#include "types.h"
+#include "OS.h"
+
+// Packet command for spectrum control
+#define SPECTRUM_COMMAND 0x5B
+// Extended frame type of the spectrum frames
+#define SPECTRUM_FRAME   0x5D
+// The most bins sent in one frame, so a command response waits behind one frame rather than a whole spectrum
+#define SPECTRUM_FRAME_BINS 64
+// Spectrum frame payload: the scan list entry, the log2 size and the first bin, then 16-bit magnitudes (LSB first)
+#define SPECTRUM_FRAME_HEADER 3
+
+// Spectrum semaphore
+OS_ECB *SpectrumSemaphore;
+
+typedef enum
+{
+  SPECTRUM_STATUS_CHECK = 0,
+  SPECTRUM_CHANNEL      = 1,
+  SPECTRUM_SIZE         = 2,
+  SPECTRUM_START        = 3,
+  SPECTRUM_STOP         = 4
+} TSpectrumControl;
+
+// Identifies each value sent in reply to SPECTRUM_STATUS_CHECK
+typedef enum
+{
+  SPECTRUM_RESULT_CYCLES_LO = 0x10,
+  SPECTRUM_RESULT_CYCLES_HI = 0x11,
+  SPECTRUM_RESULT_DROPPED   = 0x12
+} TSpectrumResult;
+
+/*! @brief Sets up the spectrum module before first use.
+ *
+ *  @return BOOL - TRUE if the spectrum module was successfully initialized.
+ */
+BOOL Spectrum_Init(void);
+
+/*! @brief Configures, starts or stops the spectra, or sends the transform statistics.
+ *
+ *  @param control The spectrum control command.
+ *  @param data The data sent with the command; the size is a power of two and a start with
+ *         data 1 runs continuously rather than once.
+ *  @return BOOL - TRUE if the command was valid.
+ *  @note The channel and size can only be changed while stopped and idle.
+ */
+BOOL Spectrum_Control(const TSpectrumControl control, const uint16union_t data);
+
+/*! @brief Adds the samples from one scan of the analog inputs to the current block.
+ *
+ *  @param samples is the array of raw samples, indexed by scan list entry.
+ *  @return void.
+ *  @note Called once per scan. A full block is handed to the spectrum thread, or dropped if
+ *        the thread is still busy with the previous one.
+ */
+void Spectrum_Put(const int16_t samples[]);
+
+/*! @brief Spectrum thread.
+ *
+ *  Windows and transforms each block and sends the magnitude spectrum in extended frames of
+ *  up to SPECTRUM_FRAME_BINS bins.
+ *  @return void.
+ *  @note Runs at a low priority so that sampling is never held up.
+ */
+void SpectrumThread(void* arg);
+
+#endif
@@ -0,0 +1,35 @@
+/*! @file
+ *
+ *  @brief Checks for the host tests.
+ *
+ *  This contains a check macro that reports each failure and counts it, so a test runs to the
+ *  end and returns non-zero if anything failed.
+ *
+ *  @author Mohammad Yasin Azimi
+ *  @date 2016-11-09
+ */
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+
+static int NbFailures;
+
+// Reports and counts a failed condition
+#define CHECK(condition, ...) \
+  do \
+  { \
+    if (!(condition)) \
+    { \
+      NbFailures++; \
+      printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+      printf(__VA_ARGS__); \
+      printf("\n"); \
+    } \
+  } while (0)
+
+// Ends a test, returning its exit status
+#define CHECK_DONE(name) \
+  (printf("%s: %s\n", (name), NbFailures ? "FAILED" : "passed"), (NbFailures != 0))
+
+#endif
@@ -0,0 +1,126 @@
+/*! @file
+ *
+ *  @brief Q15 FFT against a floating point DFT, and its cost per size.
+ *
+ *  For each transform size from 16 to 512 points, checks FFT_Transform against a double precision
+ *  DFT scaled by 1/N on a windowed block of two tones and noise, and prints the cycles taken by
+ *  FFT_Window, FFT_Transform and FFT_Magnitude.
+ *
+ *  @author Mohammad Yasin Azimi
+ *  @date 2016-11-09
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+#include "check.h"
+#include "fft.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLES_UNIT "cycles"
+#else
+#define CYCLES_UNIT "ns"
+#endif
+
+// The transforms timed at each size
+#define NB_RUNS 2000
+
+// The most a Q15 output may be from the exact DFT, in LSBs per stage
+#define FFT_TOLERANCE 1.0
+
+/*! @brief Reads the cycle counter, or the time where there is none.
+ *
+ *  @return uint64_t - The cycles, or nanoseconds.
+ */
+static uint64_t Cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+#endif
+}
+
+/*! @brief Fills a block with two tones and noise, as from an analog input.
+ *
+ *  @param data Where the block is placed.
+ *  @param size The number of samples.
+ *  @return void.
+ */
+static void Block(int16_t data[], const uint16_t size)
+{
+  for (uint16_t n = 0; n < size; n++)
+    data[n] = (int16_t)(12000 * sin(2 * M_PI * 3 * n / size) + 6000 * sin(2 * M_PI * (size / 4 + 0.5) * n / size)
+			+ rand() % 2001 - 1000);
+}
+
+int main(void)
+{
+  static int16_t samples[FFT_MAX_SIZE], real[FFT_MAX_SIZE], imaginary[FFT_MAX_SIZE];
+  static uint16_t magnitude[FFT_MAX_SIZE / 2];
+  uint64_t windowCycles, transformCycles, magnitudeCycles, start;
+  double exactReal, exactImaginary, error, maxError;
+
+  srand(1);
+  printf("  points  window  transform  magnitude  %s per block, largest error\n", CYCLES_UNIT);
+  for (uint8_t log2Size = FFT_MIN_LOG2_SIZE; log2Size <= FFT_MAX_LOG2_SIZE; log2Size++)
+  {
+    const uint16_t size = 1 << log2Size;
+
+    // The transform of the windowed block against the DFT, scaled by 1/N as the stages halve
+    Block(samples, size);
+    FFT_Window(samples, log2Size);
+    for (uint16_t n = 0; n < size; n++)
+    {
+      real[n] = samples[n];
+      imaginary[n] = 0;
+    }
+    FFT_Transform(real, imaginary, log2Size);
+
+    maxError = 0;
+    for (uint16_t k = 0; k < size; k++)
+    {
+      exactReal = 0;
+      exactImaginary = 0;
+      for (uint16_t n = 0; n < size; n++)
+      {
+	exactReal += samples[n] * cos(2 * M_PI * k * n / size);
+	exactImaginary -= samples[n] * sin(2 * M_PI * k * n / size);
+      }
+      error = fmax(fabs(real[k] - exactReal / size), fabs(imaginary[k] - exactImaginary / size));
+      if (error > maxError)
+	maxError = error;
+    }
+    CHECK(maxError <= FFT_TOLERANCE * log2Size, "%u points: %.2f LSB from the DFT", size, maxError);
+
+    windowCycles = transformCycles = magnitudeCycles = 0;
+    for (uint32_t run = 0; run < NB_RUNS; run++)
+    {
+      Block(samples, size);
+      start = Cycles();
+      FFT_Window(samples, log2Size);
+      windowCycles += Cycles() - start;
+
+      for (uint16_t n = 0; n < size; n++)
+      {
+	real[n] = samples[n];
+	imaginary[n] = 0;
+      }
+      start = Cycles();
+      FFT_Transform(real, imaginary, log2Size);
+      transformCycles += Cycles() - start;
+
+      start = Cycles();
+      FFT_Magnitude(real, imaginary, magnitude, log2Size);
+      magnitudeCycles += Cycles() - start;
+    }
+
+    printf("  %6u %7.0f %10.0f %10.0f  %.2f LSB\n", size, (double)windowCycles / NB_RUNS, (double)transformCycles / NB_RUNS,
+	   (double)magnitudeCycles / NB_RUNS, maxError);
+  }
+
+  return CHECK_DONE("fft_cycles");
+}
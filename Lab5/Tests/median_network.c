@@ -0,0 +1,92 @@
+/*! @file
+ *
+ *  @brief Median networks against Median_Filter.
+ *
+ *  A comparator network finds the median of every input if it finds the median of every input
+ *  of 0s and 1s (the 0-1 principle), so each network is checked on all 2^n such inputs. The 0s
+ *  and 1s are also checked as the two ends of the int16_t range, to catch overflow in the
+ *  branch-free compare-exchange, and every input of three levels is checked for ties.
+ *
+ *  @author Mohammad Yasin Azimi
+ *  @date 2016-11-09
+ */
+#include "check.h"
+#include "median.h"
+
+// The largest window a network is provided for, which is also the most Median_Filter handles
+#define NETWORK_MAX 11
+
+/*!
+ * @struct TNetwork
+ */
+typedef struct
+{
+  uint8_t size;				/*!< The number of samples in the window */
+  int16_t (*median)(const int16_t array[]);	/*!< The network */
+} TNetwork;
+
+static const TNetwork Networks[] =
+{
+  {3, Median_Network3},
+  {5, Median_Network5},
+  {7, Median_Network7},
+  {9, Median_Network9},
+  {11, Median_Network11}
+};
+
+/*! @brief Checks a network on every input whose samples take one of a few levels.
+ *
+ *  @param network The network.
+ *  @param levels The levels.
+ *  @param nbLevels The number of levels.
+ *  @return uint32_t - The number of inputs checked.
+ */
+static uint32_t CheckAll(const TNetwork* const network, const int16_t levels[], const uint8_t nbLevels)
+{
+  int16_t array[NETWORK_MAX] = {0};
+  uint8_t digits[NETWORK_MAX] = {0};
+  uint32_t nbInputs = 0, nbWrong = 0;
+  int16_t expected, median;
+  uint8_t sample;
+
+  // Counts through every input in base nbLevels
+  do
+  {
+    for (sample = 0; sample < network->size; sample++)
+      array[sample] = levels[digits[sample]];
+
+    expected = Median_Filter(array, network->size);
+    median = network->median(array);
+    if (median != expected)
+    {
+      if (nbWrong == 0)
+	CHECK(median == expected, "median of %u gave %d, not %d", network->size, median, expected);
+      nbWrong++;
+    }
+    nbInputs++;
+
+    for (sample = 0; (sample < network->size) && (++digits[sample] == nbLevels); sample++)
+      digits[sample] = 0;
+  } while (sample < network->size);
+
+  CHECK(nbWrong == 0, "median of %u wrong for %u of %u inputs", network->size, nbWrong, nbInputs);
+  return nbInputs;
+}
+
+int main(void)
+{
+  const int16_t zeroOne[] = {0, 1};
+  const int16_t extremes[] = {INT16_MIN, INT16_MAX};
+  const int16_t ties[] = {INT16_MIN, 0, INT16_MAX};
+  uint32_t nbInputs;
+
+  for (uint8_t networkNb = 0; networkNb < sizeof(Networks) / sizeof(Networks[0]); networkNb++)
+  {
+    nbInputs = CheckAll(&Networks[networkNb], zeroOne, 2);
+    nbInputs += CheckAll(&Networks[networkNb], extremes, 2);
+    nbInputs += CheckAll(&Networks[networkNb], ties, 3);
+    printf("  median of %2u: %6u inputs\n", Networks[networkNb].size, nbInputs);
+  }
+
+  return CHECK_DONE("median_network");
+}
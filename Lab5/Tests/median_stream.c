@@ -0,0 +1,128 @@
+/*! @file
+ *
+ *  @brief Streaming median against copy-and-quicksort.
+ *
+ *  Runs a noisy stream through a sliding window of each size from 3 to 63, finding the median
+ *  of every sample both with Median_Update on the sorted window and by copying the window and
+ *  quicksorting it as Median_Filter does. Checks the two agree and prints the cycles per sample.
+ *
+ *  @author Mohammad Yasin Azimi
+ *  @date 2016-11-09
+ */
+#include <stdlib.h>
+#include <time.h>
+#include "check.h"
+#include "median.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLES_UNIT "cycles"
+#else
+#define CYCLES_UNIT "ns"
+#endif
+
+// The window sizes benchmarked
+#define WINDOW_MIN 3
+#define WINDOW_MAX 63
+
+// The samples run through each window
+#define NB_SAMPLES 20000
+
+// The most Median_Filter's copy of the window holds
+#define FILTER_MAX 11
+
+// Defined in median.c for Median_Filter, and not declared in median.h
+void Quicksort(int16_t* arraY, int32_t sizE);
+
+/*! @brief Reads the cycle counter, or the time where there is none.
+ *
+ *  @return uint64_t - The cycles, or nanoseconds.
+ */
+static uint64_t Cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+#endif
+}
+
+/*! @brief Finds the median the way Median_Filter does, for any window size.
+ *
+ *  Median_Filter copies the window into 11 entries, so larger windows use the same steps on a larger copy.
+ *  @param array The window.
+ *  @param size The number of samples in the window.
+ *  @return int16_t - The median.
+ */
+static int16_t SortMedian(const int16_t array[], const uint32_t size)
+{
+  int16_t copyArray[WINDOW_MAX];
+
+  if (size <= FILTER_MAX)
+    return Median_Filter(array, size);
+
+  for (uint32_t index = 0; index < size; index++)
+    copyArray[index] = array[index];
+  Quicksort(copyArray, (int32_t)size);
+
+  if ((size % 2) == 0)
+    return (copyArray[(size / 2) - 1] + copyArray[size / 2]) / 2;
+  return copyArray[size / 2];
+}
+
+int main(void)
+{
+  static int16_t stream[NB_SAMPLES];
+  static int16_t expected[NB_SAMPLES];
+  int16_t values[WINDOW_MAX], sorted[WINDOW_MAX];
+  uint64_t start, sortCycles, updateCycles;
+  uint32_t nbWrong, oldest;
+  int16_t median;
+
+  // A slow ramp with noise and the odd spike, as from an analog input
+  srand(1);
+  for (uint32_t sampleNb = 0; sampleNb < NB_SAMPLES; sampleNb++)
+    stream[sampleNb] = (int16_t)((sampleNb % 4096) * 8 - 16384 + rand() % 512 - 256 + ((rand() % 64 == 0) ? 12000 : 0));
+
+  printf("  window  copy-and-quicksort  streaming  %s per sample\n", CYCLES_UNIT);
+  for (uint32_t size = WINDOW_MIN; size <= WINDOW_MAX; size++)
+  {
+    // The window starts full of 0s, as Analog_Init leaves it
+    for (uint32_t index = 0; index < size; index++)
+      values[index] = 0;
+    oldest = 0;
+    start = Cycles();
+    for (uint32_t sampleNb = 0; sampleNb < NB_SAMPLES; sampleNb++)
+    {
+      values[oldest] = stream[sampleNb];
+      oldest = (oldest + 1) % size;
+      expected[sampleNb] = SortMedian(values, size);
+    }
+    sortCycles = Cycles() - start;
+
+    for (uint32_t index = 0; index < size; index++)
+    {
+      values[index] = 0;
+      sorted[index] = 0;
+    }
+    oldest = 0;
+    nbWrong = 0;
+    start = Cycles();
+    for (uint32_t sampleNb = 0; sampleNb < NB_SAMPLES; sampleNb++)
+    {
+      median = Median_Update(sorted, size, values[oldest], stream[sampleNb]);
+      values[oldest] = stream[sampleNb];
+      oldest = (oldest + 1) % size;
+      nbWrong += (median != expected[sampleNb]);
+    }
+    updateCycles = Cycles() - start;
+
+    CHECK(nbWrong == 0, "window of %u: %u of %u medians differ", size, nbWrong, NB_SAMPLES);
+    printf("  %6u %19.1f %10.1f\n", size, (double)sortCycles / NB_SAMPLES, (double)updateCycles / NB_SAMPLES);
+  }
+
+  return CHECK_DONE("median_stream");
+}
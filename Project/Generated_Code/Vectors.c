@@ -58,6 +58,7 @@
 #include "Cpu.h"
 #include "UART.h"
 #include "PIT.h"
+#include "trigger.h"
 #include "Events.h"
 
 /* ISR prototype */
@@ -92,8 +93,8 @@ __attribute__ ((section (".vectortable"))) const tVectorTable __vect_table = { /
 	(tIsrFunc)&Cpu_Interrupt,          /* 0x0D  0x00000034   -   ivINT_Reserved13               unused by PE */
 	(tIsrFunc)&OS_ContextSwitchISR,    /* 0x0E  0x00000038   -   ivINT_PendableSrvReq           unused by PE */
 	(tIsrFunc)&OS_SysTickISR,          /* 0x0F  0x0000003C   -   ivINT_SysTick                  unused by PE */
-	(tIsrFunc)&Cpu_Interrupt,          /* 0x10  0x00000040   -   ivINT_DMA0_DMA16               unused by PE */
-	(tIsrFunc)&Cpu_Interrupt,          /* 0x11  0x00000044   -   ivINT_DMA1_DMA17               unused by PE */
+	(tIsrFunc)&UART_DMAISR,            /* 0x10  0x00000040   -   ivINT_DMA0_DMA16               unused by PE */
+	(tIsrFunc)&UART_DMAISR,            /* 0x11  0x00000044   -   ivINT_DMA1_DMA17               unused by PE */
 	(tIsrFunc)&Cpu_Interrupt,          /* 0x12  0x00000048   -   ivINT_DMA2_DMA18               unused by PE */
 	(tIsrFunc)&Cpu_Interrupt,          /* 0x13  0x0000004C   -   ivINT_DMA3_DMA19               unused by PE */
 	(tIsrFunc)&Cpu_Interrupt,          /* 0x14  0x00000050   -   ivINT_DMA4_DMA20               unused by PE */
@@ -182,7 +183,7 @@ __attribute__ ((section (".vectortable"))) const tVectorTable __vect_table = { /
 	(tIsrFunc)&Cpu_Interrupt,          /* 0x67  0x0000019C   -   ivINT_PORTA                    unused by PE */
 	(tIsrFunc)&Cpu_Interrupt,          /* 0x68  0x000001A0   -   ivINT_PORTB                    unused by PE */
 	(tIsrFunc)&Cpu_Interrupt,          /* 0x69  0x000001A4   -   ivINT_PORTC                    unused by PE */
-	(tIsrFunc)&Cpu_Interrupt,          /* 0x6A  0x000001A8   -   ivINT_PORTD                    unused by PE */
+	(tIsrFunc)&Trigger_ISR,            /* 0x6A  0x000001A8   -   ivINT_PORTD                    unused by PE */
 	(tIsrFunc)&Cpu_Interrupt,          /* 0x6B  0x000001AC   -   ivINT_PORTE                    unused by PE */
 	(tIsrFunc)&Cpu_Interrupt,          /* 0x6C  0x000001B0   -   ivINT_PORTF                    unused by PE */
 	(tIsrFunc)&Cpu_Interrupt,          /* 0x6D  0x000001B4   -   ivINT_DDR                      unused by PE */
@@ -11,12 +11,14 @@
  * @addtogroup AWG_module AWG module documentation
  * @{
 */
+#include "OS.h"
 #include "AWG.h"
 #include "types.h"
 #include "waveform.h"
+#include "PE_Types.h"
 
-static uint8_t value;
 static int32_t outcome;
+static uint16_t SampleFrequency;
 
 /*! @brief Initialises all the waveforms being used.
  *
@@ -25,30 +27,58 @@ static int32_t outcome;
  */
 void AWG_Init(const uint16_t sampleFrequency)
 {
-  Square_Init(sampleFrequency);
-  Sawtooth_Init(sampleFrequency);
+  SampleFrequency = sampleFrequency;
+}
+
+/*! @brief Checks that a frequency can be generated at the sample frequency.
+ *
+ *  @param frequency The frequency in Hz in 16.16 fixed point.
+ *  @return BOOL - TRUE if the frequency is no higher than the Nyquist frequency.
+ */
+BOOL AWG_FrequencyValid(const uint32_t frequency)
+{
+  // Half the sample frequency in 16.16 fixed point
+  return (frequency <= ((uint32_t)SampleFrequency << 15));
+}
+
+/*! @brief Calculates the phase accumulator step for a frequency.
+ *
+ *  @param frequency The frequency in Hz in 16.16 fixed point.
+ *  @return uint32_t - The phase step per sample, where 2^32 is a full period.
+ */
+uint32_t AWG_PhaseIncrement(const uint32_t frequency)
+{
+  // (frequency / 2^16) periods per second over SampleFrequency samples per second, scaled by 2^32.
+  // The step resolves SampleFrequency / 2^32 Hz, far finer than the 2^-16 Hz of the frequency word.
+  return (uint32_t)(((uint64_t)frequency << 16) / SampleFrequency);
 }
 
 /*! @brief Digital outputs the required waveform.
  *
  *  @param aAWGSettings Struct containing the parameters of the waveform.
- *  @param sampleNb The number of samples based on the period.
+ *  @param phase The position in the period, where 2^32 is a full period.
  */
-int16_t AWG_Output(const TAWGSettings aAWGSettings, const uint16_t sampleNb)
+int16_t AWG_Output(const TAWGSettings aAWGSettings, const uint32_t phase)
 {
   // Switch case to switch between the different waveforms
   switch (aAWGSettings.waveformType)
   {
     case SQUARE_WAVE:
-      outcome = Waveform_Square((uint32_t)(aAWGSettings.frequency.l << 4), sampleNb);
+      outcome = Waveform_Square(phase);
       break;
     case SAWTOOTH_WAVE:
-      outcome = Waveform_Sawtooth((uint32_t)(aAWGSettings.frequency.l << 4), sampleNb);
+      outcome = Waveform_Sawtooth(phase);
+      break;
+    case PULSE_WAVE:
+      outcome = Waveform_Pulse(phase, aAWGSettings.dutyLimit);
+      break;
+    default:
+      outcome = 0;
       break;
   }
 
   // Period sampling
-  SamplePeriod(aAWGSettings, sampleNb);
+  SamplePeriod(aAWGSettings);
 
   // Waveform magnitude
   MangnitudeCheck();
@@ -57,25 +87,147 @@ int16_t AWG_Output(const TAWGSettings aAWGSettings, const uint16_t sampleNb)
   return ((int16_t)outcome);
 }
 
+/*! @brief Publishes the staged settings of a channel to the PIT thread.
+ *
+ *  The staged settings are copied into a buffer that is neither playing nor pending and swapped
+ *  in by AWG_Update, so all of the changed parameters take effect on the same sample. A channel
+ *  that is not playing takes them straight away.
+ *  @param aChannel The channel being updated.
+ *  @return void.
+ *  @note Must only be called from one thread. Never waits; a publish not yet applied is replaced.
+ */
+void AWG_Publish(TChannel* const aChannel)
+{
+  TAWGSettings* spare;
+
+  // The PIT thread only reads the playing and pending buffers, so the third is free to fill
+  OS_DisableInterrupts();
+  for (spare = aChannel->buffer; (spare == aChannel->output) || (spare == aChannel->next); spare++)
+    ;
+  OS_EnableInterrupts();
+
+  *spare = aChannel->settings;
+
+  OS_DisableInterrupts();
+  if (aChannel->active && aChannel->running)
+  {
+    aChannel->next = spare;
+    aChannel->nextAtPeriod = aChannel->periodPending;
+  }
+  else
+  {
+    aChannel->output = spare;
+    aChannel->next = NULL;
+  }
+  OS_EnableInterrupts();
+
+  aChannel->periodPending = bFALSE;
+}
+
+/*! @brief Plays new settings on a channel from the next sample, replacing any pending publish.
+ *
+ *  The channel plays from the caller's buffer, so its own buffers and staged settings are left as they were.
+ *  @param aChannel The channel being updated.
+ *  @param aAWGSettings The settings to play, which must stay valid until the channel is published to again.
+ *  @return void.
+ *  @note Must only be called from the PIT thread.
+ */
+void AWG_Apply(TChannel* const aChannel, TAWGSettings* const aAWGSettings)
+{
+  OS_DisableInterrupts();
+  aChannel->output = aAWGSettings;
+  aChannel->next = NULL;
+  OS_EnableInterrupts();
+}
+
+/*! @brief Produces the next sample of a channel and advances its phase accumulator.
+ *
+ *  Published settings are applied first, on a sample or period boundary.
+ *  Bursts are started by a pending trigger and counted down on every wrap of the phase accumulator.
+ *  Gated channels play from the start of a period while the gate is high.
+ *  @param aChannel The channel being sampled.
+ *  @return int16_t - The digital output of the channel.
+ */
+int16_t AWG_Update(TChannel* const aChannel)
+{
+  int16_t sample;
+  uint32_t lastPhase;
+  TAWGSettings* next;
+  TAWGSettings settings;
+
+  // Apply published settings on this sample, or at the end of a period when synchronised.
+  // The packet thread can preempt this thread, so the swap and the copy played are taken together.
+  OS_DisableInterrupts();
+  next = aChannel->next;
+  if (next && (!(aChannel->periodSync || aChannel->nextAtPeriod) || aChannel->wrapped || !aChannel->running))
+  {
+    aChannel->output = next;
+    aChannel->next = NULL;
+  }
+  settings = *aChannel->output;
+  OS_EnableInterrupts();
+
+  switch (aChannel->mode)
+  {
+    case BURST_MODE:
+      // A trigger restarts the burst from the beginning of a period
+      if (aChannel->trigger)
+      {
+        aChannel->trigger    = bFALSE;
+        aChannel->phase      = 0;
+        aChannel->cyclesLeft = aChannel->nbCycles;
+        aChannel->running    = bTRUE;
+      }
+      break;
+    case GATED_MODE:
+      // The gate opening starts output from the beginning of a period
+      if (aChannel->gate && !aChannel->running)
+        aChannel->phase = 0;
+      aChannel->running = aChannel->gate;
+      break;
+    default:
+      aChannel->running = bTRUE;
+      break;
+  }
+
+  // Idle channels hold the offset level
+  if (!aChannel->running)
+  {
+    outcome = 0;
+    SamplePeriod(settings);
+    MangnitudeCheck();
+    return ((int16_t)outcome);
+  }
+
+  sample = AWG_Output(settings, aChannel->phase);
+
+  lastPhase = aChannel->phase;
+  aChannel->phase += settings.phaseIncrement;
+
+  // A full period has been played when the accumulator wraps
+  aChannel->wrapped = (aChannel->phase < lastPhase);
+  if ((aChannel->mode == BURST_MODE) && aChannel->wrapped)
+  {
+    aChannel->cyclesLeft--;
+    if (aChannel->cyclesLeft == 0)
+      aChannel->running = bFALSE;
+  }
+
+  return sample;
+}
+
 /*! @brief Calculates the sampling output of the waveform.
  *
  *  @param aAWGSettings Struct containing the parameters of all the waveform.
- *  @param sampleNb The number of samples based on the period.
  *  @return void.
  */
-void SamplePeriod(const TAWGSettings aAWGSettings, const uint16_t sampleNb)
+void SamplePeriod(const TAWGSettings aAWGSettings)
 {
-  if (((sampleNb % 100) < 50) && (outcome < 0))
-    value = 1;
-
   // The final output is calculated in volts
   outcome = (outcome * aAWGSettings.amplitude.l);
   outcome += (aAWGSettings.offset.l << 12);
   outcome /= 16;
   outcome = outcome >> 12;
-
-  if (((sampleNb % 100) < 50) && (outcome < 0))
-    value = 1;
 }
 
 /*! @brief Checks if the magnitude of the waveform is larger than 10V.
@@ -24,7 +24,16 @@ typedef enum
   OFFSET_CHANGE      	= 4,
   CHANNEL_START   	= 5,
   CHANNEL_STOP    	= 6,
-  CHANNEL_CHANGE  	= 7
+  CHANNEL_CHANGE  	= 7,
+  MODE_CHANGE     	= 8,
+  BURST_CHANGE    	= 9,
+  CHANNEL_TRIGGER 	= 10,
+  UPDATE_HOLD     	= 11,
+  UPDATE_COMMIT   	= 12,
+  UPDATE_SYNC     	= 13,
+  FREQUENCY_LO    	= 14,
+  FREQUENCY_HI    	= 15,
+  DUTY_CHANGE     	= 16
 }TFGControl;
 
 typedef enum
@@ -34,21 +43,47 @@ typedef enum
   TRIANGLE_WAVE  	= 2,
   SAWTOOTH_WAVE  	= 3,
   NOISE_WAVE     	= 4,
-  ARBITRARY_WAVE 	= 5
+  ARBITRARY_WAVE 	= 5,
+  PULSE_WAVE     	= 6
 }TWaveform;
 
+typedef enum
+{
+  CONTINUOUS_MODE	= 0,
+  BURST_MODE		= 1,
+  GATED_MODE		= 2
+}TOutputMode;
+
 typedef struct
 {
   TWaveform     	waveformType;
-  uint16union_t 	frequency;
+  uint32union_t 	frequency;		/*!< The frequency in Hz in 16.16 fixed point */
   uint16union_t 	amplitude;
   int16union_t  	offset;
+  uint32_t		phaseIncrement;		/*!< Phase accumulator step per sample, derived from the frequency */
+  uint16union_t		duty;			/*!< The pulse duty cycle as a fraction of 2^16 */
+  uint32_t		dutyLimit;		/*!< The phase at which the pulse goes low, derived from the duty cycle */
 }TAWGSettings;
 
 typedef struct
 {
   BOOL     		active;
-  TAWGSettings		output;
+  TAWGSettings		settings;		/*!< Staged settings, edited by the packet thread */
+  TAWGSettings		buffer[3];		/*!< Settings playing, pending and being filled by the packet thread */
+  TAWGSettings* volatile	output;			/*!< The published settings being played */
+  TAWGSettings* volatile	next;			/*!< Published settings waiting for a boundary, or NULL */
+  BOOL			hold;			/*!< TRUE while changes are staged for a single commit */
+  BOOL			periodSync;		/*!< TRUE to apply new settings at a period boundary rather than a sample boundary */
+  BOOL			wrapped;		/*!< TRUE if the last sample completed a period */
+  BOOL			periodPending;		/*!< TRUE if the staged changes must wait for a period boundary */
+  BOOL volatile		nextAtPeriod;		/*!< TRUE if the published settings wait for a period boundary */
+  uint32_t		phase;			/*!< Phase accumulator, a full period is 2^32 */
+  TOutputMode		mode;			/*!< Continuous, burst or gated output */
+  uint16_t		nbCycles;		/*!< The number of periods played per burst */
+  uint16_t		cyclesLeft;		/*!< The periods left in the current burst */
+  BOOL			running;		/*!< TRUE while a burst is playing or the gate is open */
+  BOOL volatile		trigger;		/*!< Set by the trigger to start a burst on the next sample */
+  BOOL volatile		gate;			/*!< The level of the gate input */
 }TChannel;
 
 /*! @brief Initialises all the waveforms being used.
@@ -58,20 +93,64 @@ typedef struct
  */
 void AWG_Init(const uint16_t sampleFrequency);
 
+/*! @brief Checks that a frequency can be generated at the sample frequency.
+ *
+ *  @param frequency The frequency in Hz in 16.16 fixed point.
+ *  @return BOOL - TRUE if the frequency is no higher than the Nyquist frequency.
+ */
+BOOL AWG_FrequencyValid(const uint32_t frequency);
+
+/*! @brief Calculates the phase accumulator step for a frequency.
+ *
+ *  @param frequency The frequency in Hz in 16.16 fixed point.
+ *  @return uint32_t - The phase step per sample, where 2^32 is a full period.
+ */
+uint32_t AWG_PhaseIncrement(const uint32_t frequency);
+
 /*! @brief Digital outputs the required waveform.
  *
  *  @param aAWGSettings Struct containing the parameters of the waveform.
- *  @param sampleNb The number of samples based on the period.
+ *  @param phase The position in the period, where 2^32 is a full period.
+ */
+int16_t AWG_Output(const TAWGSettings aAWGSettings, const uint32_t phase);
+
+/*! @brief Publishes the staged settings of a channel to the PIT thread.
+ *
+ *  The staged settings are copied into a buffer that is neither playing nor pending and swapped
+ *  in by AWG_Update, so all of the changed parameters take effect on the same sample. A channel
+ *  that is not playing takes them straight away.
+ *  @param aChannel The channel being updated.
+ *  @return void.
+ *  @note Must only be called from one thread. Never waits; a publish not yet applied is replaced.
+ */
+void AWG_Publish(TChannel* const aChannel);
+
+/*! @brief Plays new settings on a channel from the next sample, replacing any pending publish.
+ *
+ *  The channel plays from the caller's buffer, so its own buffers and staged settings are left as they were.
+ *  @param aChannel The channel being updated.
+ *  @param aAWGSettings The settings to play, which must stay valid until the channel is published to again.
+ *  @return void.
+ *  @note Must only be called from the PIT thread.
+ */
+void AWG_Apply(TChannel* const aChannel, TAWGSettings* const aAWGSettings);
+
+/*! @brief Produces the next sample of a channel and advances its phase accumulator.
+ *
+ *  Published settings are applied first, on a sample or period boundary.
+ *  Bursts are started by a pending trigger and counted down on every wrap of the phase accumulator.
+ *  Gated channels play from the start of a period while the gate is high.
+ *  @param aChannel The channel being sampled.
+ *  @return int16_t - The digital output of the channel.
  */
-int16_t AWG_Output(const TAWGSettings aAWGSettings, const uint16_t sampleNb);
+int16_t AWG_Update(TChannel* const aChannel);
 
 /*! @brief Calculates the sampling output of the waveform.
  *
  *  @param aAWGSettings Struct containing the parameters of the waveform.
- *  @param sampleNb The number of samples based on the period.
  *  @return void.
  */
-void SamplePeriod(const TAWGSettings aAWGSettings, const uint16_t sampleNb);
+void SamplePeriod(const TAWGSettings aAWGSettings);
 
 /*! @brief Checks if the magnitude of the waveform is larger than 10V.
  *
@@ -25,14 +25,29 @@ void FIFO_Init(TFIFO * const FIFO)
 {
   // Creates semaphores for signaling between the threads
   FIFO->BufferAccess = OS_SemaphoreCreate(1);
-  FIFO->SpaceAvailable = OS_SemaphoreCreate(FIFO_SIZE);
+  FIFO->SpaceAvailable = OS_SemaphoreCreate(0);
   FIFO->ItemsAvailable = OS_SemaphoreCreate(0);
 
   // FIFO initialization
   FIFO->Start = 0;
   FIFO->End = 0;
   FIFO->NbBytes = 0;
-  FIFO ->Buffer[FIFO_SIZE];
+  FIFO->SpaceWaiters = 0;
+  FIFO->ItemsWaiters = 0;
+}
+
+/*! @brief Wakes every thread waiting on one side of the FIFO.
+ *
+ *  @param semaphore The semaphore the threads are waiting on.
+ *  @param waiters A pointer to the number of threads waiting.
+ *  @return void.
+ *  @note Must be called with exclusive access to the FIFO.
+ */
+static void WakeWaiters(OS_ECB* const semaphore, uint8_t* const waiters)
+{
+  // Each woken thread checks the FIFO again and waits again if it still cannot proceed
+  for (; *waiters > 0; (*waiters)--)
+    OS_SemaphoreSignal(semaphore);
 }
 
 /*! @brief Put one character into the FIFO.
@@ -44,24 +59,7 @@ void FIFO_Init(TFIFO * const FIFO)
  */
 void FIFO_Put(TFIFO * const FIFO, const uint8_t data)
 {
-  OS_ERROR error;
-
-  // This waits for space to become available
-  error = OS_SemaphoreWait(FIFO->SpaceAvailable, 0);
-  // This obtains exclusive access to the FIFO
-  error = OS_SemaphoreWait(FIFO->BufferAccess, 0);
-
-  // Place data in FIFO
-  FIFO->Buffer[FIFO->End] = data;
-  // Increment bytes in FIFO
-  FIFO->NbBytes++;
-  // Increments tail pointer location by 1 (if reached end of buffer)
-  FIFO->End = (FIFO->End + 1) % FIFO_SIZE;
-
-  // This relinquishes exclusive access to the FIFO
-  OS_SemaphoreSignal(FIFO->BufferAccess);
-  // This increments the number of items available in FIFO
-  OS_SemaphoreSignal(FIFO->ItemsAvailable);
+  FIFO_PutBlock(FIFO, &data, 1);
 }
 
 /*! @brief Get one character from the FIFO.
@@ -73,24 +71,107 @@ void FIFO_Put(TFIFO * const FIFO, const uint8_t data)
  */
 void FIFO_Get(TFIFO * const FIFO, uint8_t * const dataPtr)
 {
-  OS_ERROR error;
-
-  // This waits for space to become available
-  error = OS_SemaphoreWait(FIFO->ItemsAvailable, 0);
-  // This obtains exclusive access to the FIFO
-  error = OS_SemaphoreWait(FIFO->BufferAccess, 0);
-
-  // Oldest data in FIFO put to dataPtr
-  *dataPtr = FIFO->Buffer[FIFO->Start];
-  // Decrement count of FIFO bytes
-  FIFO->NbBytes--;
-  //
-  FIFO->Start = (FIFO->Start + 1) % FIFO_SIZE;
-
-  // This relinquishes exclusive access to the FIFO
-  OS_SemaphoreSignal(FIFO->BufferAccess);
-  // This increments the number of items available in FIFO
-  OS_SemaphoreSignal(FIFO->SpaceAvailable);
+  FIFO_GetBlock(FIFO, dataPtr, 1);
+}
+
+/*! @brief Put a block of bytes into the FIFO.
+ *
+ *  Space for the whole block is reserved and the block copied in under a single acquisition
+ *  of the FIFO, so a block no longer than FIFO_SIZE is never interleaved with other data.
+ *  @param FIFO A pointer to a FIFO struct where data is to be stored.
+ *  @param data The bytes to store in the FIFO buffer.
+ *  @param length The number of bytes to store.
+ *  @return void.
+ *  @note Assumes that FIFO_Init has been called. Longer blocks are put in FIFO_SIZE pieces.
+ */
+void FIFO_PutBlock(TFIFO* const FIFO, const uint8_t data[], const uint16_t length)
+{
+  uint16_t done = 0, piece;
+
+  while (done < length)
+  {
+    piece = length - done;
+    if (piece > FIFO_SIZE)
+      piece = FIFO_SIZE;
+
+    // This obtains exclusive access to the FIFO
+    (void)OS_SemaphoreWait(FIFO->BufferAccess, 0);
+
+    // This waits for space for the whole piece to become available
+    if (FIFO_SIZE - FIFO->NbBytes < piece)
+    {
+      FIFO->SpaceWaiters++;
+      OS_SemaphoreSignal(FIFO->BufferAccess);
+      (void)OS_SemaphoreWait(FIFO->SpaceAvailable, 0);
+      continue;
+    }
+
+    // Place data in FIFO
+    for (uint16_t byte = 0; byte < piece; byte++)
+    {
+      FIFO->Buffer[FIFO->End] = data[done + byte];
+      // Increments tail pointer location by 1 (if reached end of buffer)
+      FIFO->End = (FIFO->End + 1) % FIFO_SIZE;
+    }
+    // Increment bytes in FIFO
+    FIFO->NbBytes += piece;
+    done += piece;
+
+    // This tells the getters that items are available
+    WakeWaiters(FIFO->ItemsAvailable, &FIFO->ItemsWaiters);
+
+    // This relinquishes exclusive access to the FIFO
+    OS_SemaphoreSignal(FIFO->BufferAccess);
+  }
+}
+
+/*! @brief Get a block of bytes from the FIFO.
+ *
+ *  @param FIFO A pointer to a FIFO struct with data to be retrieved.
+ *  @param data A pointer to memory to place the retrieved bytes.
+ *  @param length The number of bytes to retrieve.
+ *  @return void.
+ *  @note Assumes that FIFO_Init has been called. Waits until all the bytes have been retrieved.
+ */
+void FIFO_GetBlock(TFIFO* const FIFO, uint8_t data[], const uint16_t length)
+{
+  uint16_t done = 0, piece;
+
+  while (done < length)
+  {
+    // This obtains exclusive access to the FIFO
+    (void)OS_SemaphoreWait(FIFO->BufferAccess, 0);
+
+    // This waits for items to become available
+    if (FIFO->NbBytes == 0)
+    {
+      FIFO->ItemsWaiters++;
+      OS_SemaphoreSignal(FIFO->BufferAccess);
+      (void)OS_SemaphoreWait(FIFO->ItemsAvailable, 0);
+      continue;
+    }
+
+    // Takes as much of the block as the FIFO holds
+    piece = length - done;
+    if (piece > FIFO->NbBytes)
+      piece = FIFO->NbBytes;
+
+    // Oldest data in FIFO put to data
+    for (uint16_t byte = 0; byte < piece; byte++)
+    {
+      data[done + byte] = FIFO->Buffer[FIFO->Start];
+      FIFO->Start = (FIFO->Start + 1) % FIFO_SIZE;
+    }
+    // Decrement count of FIFO bytes
+    FIFO->NbBytes -= piece;
+    done += piece;
+
+    // This tells the putters that space is available
+    WakeWaiters(FIFO->SpaceAvailable, &FIFO->SpaceWaiters);
+
+    // This relinquishes exclusive access to the FIFO
+    OS_SemaphoreSignal(FIFO->BufferAccess);
+  }
 }
 
 /*!
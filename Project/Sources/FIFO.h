@@ -27,9 +27,12 @@ typedef struct
   uint16_t volatile NbBytes;  	/*!< The number of bytes currently stored in the FIFO */
   uint8_t Buffer[FIFO_SIZE];  	/*!< The actual array of bytes to store the data */
 
+  uint8_t SpaceWaiters;		/*!< The number of threads waiting for space */
+  uint8_t ItemsWaiters;		/*!< The number of threads waiting for bytes */
+
   OS_ECB *BufferAccess;		/*!< Pointer for access to the buffer in FIFO */
-  OS_ECB *SpaceAvailable;	/*!< Pointer for availability of space in FIFO */
-  OS_ECB *ItemsAvailable;	/*!< Pointer for availability of bytes in FIFO */
+  OS_ECB *SpaceAvailable;	/*!< Pointer for availability of space in FIFO, signalled once per waiter */
+  OS_ECB *ItemsAvailable;	/*!< Pointer for availability of bytes in FIFO, signalled once per waiter */
 } TFIFO;
 
 /*! @brief Initialize the FIFO before first use.
@@ -57,4 +60,26 @@ void FIFO_Put(TFIFO* const FIFO, const uint8_t data);
  */
 void FIFO_Get(TFIFO * const FIFO, uint8_t * const dataPtr);
 
+/*! @brief Put a block of bytes into the FIFO.
+ *
+ *  Space for the whole block is reserved and the block copied in under a single acquisition
+ *  of the FIFO, so a block no longer than FIFO_SIZE is never interleaved with other data.
+ *  @param FIFO A pointer to a FIFO struct where data is to be stored.
+ *  @param data The bytes to store in the FIFO buffer.
+ *  @param length The number of bytes to store.
+ *  @return void.
+ *  @note Assumes that FIFO_Init has been called. Longer blocks are put in FIFO_SIZE pieces.
+ */
+void FIFO_PutBlock(TFIFO* const FIFO, const uint8_t data[], const uint16_t length);
+
+/*! @brief Get a block of bytes from the FIFO.
+ *
+ *  @param FIFO A pointer to a FIFO struct with data to be retrieved.
+ *  @param data A pointer to memory to place the retrieved bytes.
+ *  @param length The number of bytes to retrieve.
+ *  @return void.
+ *  @note Assumes that FIFO_Init has been called. Waits until all the bytes have been retrieved.
+ */
+void FIFO_GetBlock(TFIFO* const FIFO, uint8_t data[], const uint16_t length);
+
 #endif
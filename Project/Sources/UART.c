@@ -13,31 +13,469 @@
  */
 #include "OS.h"
 #include "UART.h"
-#include "FIFO.h"
+#include "ring.h"
 #include "types.h"
 #include "packet.h"
 #include "MK70F12.h"
 #include "PE_Types.h"
 
-static TFIFO TxFIFO, RxFIFO;
+// The most a waiting thread asks for before it is woken, so a long block is moved in pieces
+#define UART_WATERMARK (RING_SIZE / 2)
+
+// eDMA channels and their DMAMUX request sources
+#define UART_RX_DMA_CHANNEL 0
+#define UART_TX_DMA_CHANNEL 1
+#define UART2_RX_DMA_SOURCE 6
+#define UART2_TX_DMA_SOURCE 7
+
+// Bytes in each class's transmit frame buffer, a power of two
+#define UART_TX_SIZE 1024
+
+#if (UART_TX_SIZE & (UART_TX_SIZE - 1)) != 0
+#error UART_TX_SIZE must be a power of two
+#endif
+
+// The largest baud rate error accepted, in parts per million
+#define UART_MAX_BAUD_ERROR 30000
+
+/*!
+ * @struct TFrameHeader
+ */
+typedef struct
+{
+  uint16_t size;		/*!< The bytes the record takes in the buffer, including this header */
+  uint16_t length;		/*!< The number of bytes in the frame, 0 for padding up to the end of the buffer */
+  uint32_t volatile committed;	/*!< Non-zero once the producer has finished writing the frame */
+  uint32_t time;		/*!< The OS clock when the frame was committed */
+  uint32_t spare;		/*!< Keeps the header a power of two long */
+} TFrameHeader;
+
+/*!
+ * @struct TTxQueue
+ */
+typedef struct
+{
+  uint32_t buffer[UART_TX_SIZE / sizeof(uint32_t)];	/*!< Frame records, each a header followed by the frame */
+  uint16_t volatile reserved;	/*!< The number of buffer bytes ever reserved by producers */
+  uint16_t volatile released;	/*!< The number of buffer bytes ever sent or dropped */
+  uint16_t volatile nbFrames;	/*!< The number of frames reserved and not yet sent or dropped */
+  uint16_t maxFrames;		/*!< The most frames queued at once since the counters were reset */
+  uint16_t limit;		/*!< The frames queued before the oldest is dropped, 0 to wait for space instead */
+  uint32_t nbSent;		/*!< The number of frames sent since the counters were reset */
+  uint32_t nbDropped;		/*!< The number of frames dropped since the counters were reset */
+  uint32_t latencySum;		/*!< The clock ticks sent frames spent queued, summed */
+  uint32_t latencyMax;		/*!< The most clock ticks a sent frame spent queued */
+} TTxQueue;
+
+static TRing RxRing;
+
+static TTxQueue TxQueue[UART_NB_CLASSES];	/*!< The transmit queue of each class, in priority order */
+static TTxQueue* volatile TxDMAQueue;	/*!< The queue the transmit DMA is sending from, NULL while it is idle */
+static BOOL volatile TxHold;		/*!< TRUE while frames are held back for a baud rate switch */
+static uint8_t volatile TxSpaceWaiters;	/*!< The number of producers waiting for TxSpace */
+
+static OS_ECB *TxSpace;			/*!< Wakes producers waiting for space in the transmit buffer */
+static OS_ECB *RxItems;			/*!< Wakes the consumer waiting for received bytes */
+static uint16_t volatile RxItemsNeeded;	/*!< The received bytes the consumer is waiting for, 0 if it is not waiting */
+
+static uint8_t TxFifoDepth;		/*!< The number of bytes the transmit FIFO holds */
+static uint8_t RxFifoDepth;		/*!< The number of bytes the receive FIFO holds */
+static uint32_t volatile NbInterrupts;	/*!< The number of UART2 interrupts since the counters were reset */
+static uint32_t volatile NbRxBytes;	/*!< The number of bytes received since the counters were reset */
+static uint32_t volatile NbRxOverruns;	/*!< The number of received bytes overwritten before they were taken since the counters were reset */
+static uint16_t RxPosition;		/*!< The receive DMA's write position when the receive ring was last synchronised */
+static uint32_t volatile NbTxBytes;	/*!< The number of bytes transmitted since the counters were reset */
+
+static uint32_t ModuleClk;		/*!< The module clock rate in Hz */
+static uint32_t InitBaudRate;		/*!< The baud rate set by UART_Init, fallen back to if a new rate is not confirmed */
+static uint32_t NextBaudRate;		/*!< A negotiated baud rate waiting to be switched to, 0 if there is none */
+
+static void (*UserFunction)(void*);	/*!< Called from the ISRs whenever received bytes are published */
+static void* UserArguments;		/*!< The arguments passed to UserFunction */
+
+/*! @brief Waits until a ring has enough bytes.
+ *
+ *  The amount needed is published before the ring is checked again, so the ISR either sees it
+ *  and signals once it is available, or has already made it available and the check succeeds.
+ *  A signal left over from a check that succeeded only causes one extra pass round the loop.
+ *  @param ring The ring being waited on.
+ *  @param needed The number of bytes needed, at most UART_WATERMARK.
+ *  @param semaphore The semaphore the ISR signals.
+ *  @param waitingFor Where the amount needed is published to the ISR.
+ *  @param timeout The number of clock ticks to wait for each signal, 0 to wait forever.
+ *  @return BOOL - TRUE if the bytes are available, FALSE if the wait timed out.
+ */
+static BOOL Wait(const TRing* const ring, const uint16_t needed, OS_ECB* const semaphore, uint16_t volatile* const waitingFor, const uint32_t timeout)
+{
+  for (;;)
+  {
+    if (Ring_Count(ring) >= needed)
+      return bTRUE;
+
+    *waitingFor = needed;
+    if (Ring_Count(ring) >= needed)
+    {
+      *waitingFor = 0;
+      return bTRUE;
+    }
+    if (OS_SemaphoreWait(semaphore, timeout) == OS_TIMEOUT)
+    {
+      // A signal sent after this only causes one extra pass round the loop on the next wait
+      *waitingFor = 0;
+      return bFALSE;
+    }
+  }
+}
+
+/*! @brief Wakes a thread waiting on a ring once what it asked for is available.
+ *
+ *  @param semaphore The semaphore the thread waits on.
+ *  @param waitingFor The amount the thread is waiting for, 0 if it is not waiting.
+ *  @param available The bytes now available in the ring.
+ *  @return void.
+ *  @note Called from the ISR, so a thread is only woken once per frame or watermark rather than per byte.
+ */
+static void Wake(OS_ECB* const semaphore, uint16_t volatile* const waitingFor, const uint16_t available)
+{
+  if (*waitingFor && (available >= *waitingFor))
+  {
+    *waitingFor = 0;
+    OS_SemaphoreSignal(semaphore);
+  }
+}
+
+/*! @brief Publishes the bytes the receive DMA has written into the receive ring since the last call.
+ *
+ *  @return void.
+ *  @note Only called from the ISRs, which act as the ring's producer. The DMA keeps writing round
+ *  the buffer regardless, so if the consumer falls a whole ring behind the oldest unread bytes are
+ *  overwritten. These are counted in NbRxOverruns, and the bytes written over them are published
+ *  once there is space again, so the packet parser has to resynchronise.
+ */
+static void RxSync(void)
+{
+  uint16_t position, nbBytes, nbNew, space;
+
+  // CITER counts down from RING_SIZE to 1 and then reloads, so it gives the DMA's write position
+  position = (RING_SIZE - (DMA_TCD0_CITER_ELINKNO & DMA_CITER_ELINKNO_CITER_MASK)) & (RING_SIZE - 1);
+  nbBytes = (uint16_t)(position - RxRing.Head) & (RING_SIZE - 1);
+  nbNew = (uint16_t)(position - RxPosition) & (RING_SIZE - 1);
+  RxPosition = position;
+
+  // Bytes left over from an earlier overrun were counted then, so only new bytes can add to it
+  space = Ring_Space(&RxRing);
+  if (nbBytes > space)
+  {
+    NbRxOverruns += (nbBytes - space < nbNew) ? nbBytes - space : nbNew;
+    nbBytes = space;
+  }
+
+  Ring_Advance(&RxRing, nbBytes);
+  NbRxBytes += nbBytes;
+
+  if (UserFunction && nbBytes)
+    (*UserFunction)(UserArguments);
+  Wake(RxItems, &RxItemsNeeded, Ring_Count(&RxRing));
+}
+
+/*! @brief Gets the header of the record at a position in a transmit queue.
+ *
+ *  @param queue The transmit queue.
+ *  @param position A free-running position in its buffer.
+ *  @return TFrameHeader* - The header.
+ */
+static TFrameHeader* Record(TTxQueue* const queue, const uint16_t position)
+{
+  return (TFrameHeader*)((uint8_t*)queue->buffer + (position & (UART_TX_SIZE - 1)));
+}
+
+/*! @brief Starts the transmit DMA on the oldest committed frame of the highest class waiting.
+ *
+ *  Classes are only chosen between at frame boundaries, so a control frame goes out as soon as
+ *  the frame being sent has finished, ahead of any queued telemetry.
+ *  @return void.
+ *  @note Called from the DMA ISR or with interrupts disabled, as the DMA is the queues' only consumer.
+ */
+static void TxStart(void)
+{
+  TTxQueue* queue;
+  TFrameHeader* header;
+  uint32_t latency;
+
+  if (TxDMAQueue || TxHold)
+    return;
+
+  for (queue = TxQueue; queue < &TxQueue[UART_NB_CLASSES]; queue++)
+    while (queue->released != queue->reserved)
+    {
+      header = Record(queue, queue->released);
+
+      // Frames of a class go out in the order they were reserved, so a later frame waits for an earlier one
+      if (!header->committed)
+        break;
+
+      if (header->length == 0)
+      {
+        queue->released += header->size;
+        continue;
+      }
+
+      latency = OS_TimeGet() - header->time;
+      queue->latencySum += latency;
+      if (latency > queue->latencyMax)
+        queue->latencyMax = latency;
+
+      // The DMA reads the frame straight out of the buffer
+      TxDMAQueue = queue;
+      DMA_TCD1_SADDR = (uint32_t)(header + 1);
+      DMA_TCD1_CITER_ELINKNO = DMA_CITER_ELINKNO_CITER(header->length);
+      DMA_TCD1_BITER_ELINKNO = DMA_BITER_ELINKNO_BITER(header->length);
+      DMA_SERQ = DMA_SERQ_SERQ(UART_TX_DMA_CHANNEL);
+      return;
+    }
+}
+
+/*! @brief Drops the oldest frame of a transmit queue that is not being sent or written.
+ *
+ *  A frame at the front of the buffer gives its space back at once. One behind a frame being
+ *  sent or written becomes padding, so it is no longer counted or sent, and its space comes
+ *  back when the frames before it have gone.
+ *  @param queue The transmit queue.
+ *  @param frontOnly TRUE to drop only a frame whose space comes back at once.
+ *  @return BOOL - TRUE if a frame was dropped.
+ *  @note Called with interrupts disabled.
+ */
+static BOOL DropOldest(TTxQueue* const queue, const BOOL frontOnly)
+{
+  TFrameHeader* header = NULL;
+  uint16_t position;
+  BOOL front = bTRUE;
+
+  for (position = queue->released; position != queue->reserved; position += header->size)
+  {
+    header = Record(queue, position);
+
+    if (((position == queue->released) && (TxDMAQueue == queue)) || !header->committed)
+      front = bFALSE;
+    else if (header->length)
+      break;
+  }
+
+  if ((position == queue->reserved) || (frontOnly && !front))
+    return bFALSE;
+
+  queue->nbFrames--;
+  queue->nbDropped++;
+
+  if (front)
+    queue->released = position + header->size;
+  else
+    header->length = 0;
+
+  return bTRUE;
+}
+
+/*! @brief Reserves a record for a frame in a transmit queue.
+ *
+ *  A record never wraps round the end of the buffer, so a padding record fills the space
+ *  left at the end when the frame does not fit before it. A queue with a limit drops its
+ *  oldest frames to stay within it, and to make room where that frees space at once.
+ *  @param queue The transmit queue.
+ *  @param length The number of bytes in the frame.
+ *  @return TFrameHeader* - The header of the record, or NULL if there is not enough space.
+ *  @note Called with interrupts disabled, as the producers share the queue.
+ */
+static TFrameHeader* Allocate(TTxQueue* const queue, const uint16_t length)
+{
+  TFrameHeader* header;
+  uint16_t size, padding, toEnd;
+
+  // Records are whole multiples of the header, so the padding can always hold a header
+  size = (sizeof(TFrameHeader) + length + sizeof(TFrameHeader) - 1) & ~(sizeof(TFrameHeader) - 1);
+  toEnd = UART_TX_SIZE - (queue->reserved & (UART_TX_SIZE - 1));
+  padding = (size > toEnd) ? toEnd : 0;
+
+  if (queue->limit)
+  {
+    // The frame being sent is never dropped, so the limit holds while one is on the wire
+    while ((queue->nbFrames >= queue->limit) && DropOldest(queue, bFALSE))
+      ;
+    // Only frames at the front give space back, otherwise the producer waits for the frame being sent
+    while ((UART_TX_SIZE - (uint16_t)(queue->reserved - queue->released) < padding + size) && DropOldest(queue, bTRUE))
+      ;
+  }
+
+  if (UART_TX_SIZE - (uint16_t)(queue->reserved - queue->released) < padding + size)
+    return NULL;
+
+  if (padding)
+  {
+    header = Record(queue, queue->reserved);
+    header->size = padding;
+    header->length = 0;
+    header->committed = 1;
+    queue->reserved += padding;
+  }
+
+  header = Record(queue, queue->reserved);
+  header->size = size;
+  header->length = length;
+  header->committed = 0;
+  queue->reserved += size;
+
+  queue->nbFrames++;
+  if (queue->nbFrames > queue->maxFrames)
+    queue->maxFrames = queue->nbFrames;
+
+  return header;
+}
+
+/*! @brief Clears the counters of the transmit queues.
+ *
+ *  @return void.
+ *  @note Called with interrupts disabled.
+ */
+static void ResetTxStats(void)
+{
+  for (TTxQueue* queue = TxQueue; queue < &TxQueue[UART_NB_CLASSES]; queue++)
+  {
+    queue->maxFrames = queue->nbFrames;
+    queue->nbSent = 0;
+    queue->nbDropped = 0;
+    queue->latencySum = 0;
+    queue->latencyMax = 0;
+  }
+}
+
+/*! @brief Works out the baud rate divisor nearest to a baud rate.
+ *
+ *  @param baudRate The desired baud rate in bits/sec.
+ *  @param divisor A pointer to where 32 * SBR + BRFA is placed.
+ *  @param error A pointer to where the error of the actual baud rate is placed, in parts per million.
+ *  @return BOOL - TRUE if the divisor fits SBR and BRFA and the error is acceptable.
+ */
+static BOOL Divisor(const uint32_t baudRate, uint32_t* const divisor, int32_t* const error)
+{
+  if (baudRate == 0)
+    return bFALSE;
+
+  // SBR + BRFA / 32 = moduleClk / (16 * baudRate), so 32 * SBR + BRFA = 2 * moduleClk / baudRate
+  *divisor = (2 * ModuleClk + baudRate / 2) / baudRate;
+
+  // SBR is 13 bits and cannot be 0
+  if ((*divisor < 32) || (*divisor > (8191 * 32 + 31)))
+    return bFALSE;
+
+  *error = (int32_t)(((int64_t)2 * ModuleClk * 1000000 / *divisor - (int64_t)baudRate * 1000000) / baudRate);
+
+  return (*error <= UART_MAX_BAUD_ERROR) && (*error >= -UART_MAX_BAUD_ERROR);
+}
+
+/*! @brief Writes a baud rate divisor to SBR and BRFA.
+ *
+ *  @param divisor 32 * SBR + BRFA.
+ *  @return void.
+ *  @note The transmitter and receiver must be disabled.
+ */
+static void SetDivisor(const uint32_t divisor)
+{
+  // BDH is latched until BDL is written
+  UART2_BDH = (UART2_BDH & ~UART_BDH_SBR_MASK) | UART_BDH_SBR(divisor >> 13);
+  UART2_BDL = (uint8_t)(divisor >> 5);
+  UART2_C4 = (UART2_C4 & ~UART_C4_BRFA_MASK) | UART_C4_BRFA(divisor);
+}
+
+/*! @brief Switches to a new baud rate once everything queued at the old rate has been sent.
+ *
+ *  @param baudRate The new baud rate in bits/sec.
+ *  @return BOOL - TRUE if the baud rate was set.
+ */
+static BOOL SwitchBaudRate(const uint32_t baudRate)
+{
+  uint32_t divisor;
+  int32_t error;
+
+  if (!Divisor(baudRate, &divisor, &error))
+    return bFALSE;
+
+  // Holds back further frames first, as the DMA ISR chains frames while any are queued
+  OS_DisableInterrupts();
+  TxHold = bTRUE;
+  OS_EnableInterrupts();
+
+  // Waits for the frame on the wire to leave the DMA and the shift register
+  while (TxDMAQueue || !(UART2_S1 & UART_S1_TC_MASK))
+    OS_TimeDelay(1);
+
+  UART2_C2 &= ~(UART_C2_TE_MASK | UART_C2_RE_MASK);
+  SetDivisor(divisor);
+  UART2_C2 |= UART_C2_TE_MASK | UART_C2_RE_MASK;
+
+  // Frames queued in the meantime go out at the new rate
+  OS_DisableInterrupts();
+  TxHold = bFALSE;
+  TxStart();
+  OS_EnableInterrupts();
+
+  return bTRUE;
+}
+
+/*! @brief Decodes a FIFO size field of UART2_PFIFO.
+ *
+ *  @param size The TXFIFOSIZE or RXFIFOSIZE field.
+ *  @return uint8_t - The number of bytes the FIFO holds.
+ */
+static uint8_t FifoDepth(const uint8_t size)
+{
+  // 0 is a single data word, otherwise the depth is 2^(size + 1)
+  if (size == 0)
+    return 1;
+  return (uint8_t)(1 << (size + 1));
+}
 
 /*! @brief Sets up the UART interface before first use.
  *
  *  @param baudRate The desired baud rate in bits/sec.
  *  @param moduleClk The module clock rate in Hz
+ *  @param userFunction is a pointer to a user callback function called from the ISRs whenever received bytes arrive, or NULL.
+ *  @param userArguments is a pointer to the user arguments to use with the user callback function.
  *  @return BOOL - TRUE if the UART was successfully initialized.
+ *  @note A callback becomes the only consumer of the received bytes, so UART_InBlock and UART_InWait must not be used with it.
  */
-BOOL UART_Init(const uint32_t baudRate, const uint32_t moduleClk)
+BOOL UART_Init(const uint32_t baudRate, const uint32_t moduleClk, void (*userFunction)(void*), void* userArguments)
 {
-  uint32_t brfa, sbr;
+  uint32_t divisor;
+  int32_t error;
 
-  // Initialises FIFO
-  FIFO_Init(&TxFIFO);
-  FIFO_Init(&RxFIFO);
+  ModuleClk = moduleClk;
+  UserFunction = userFunction;
+  UserArguments = userArguments;
+  InitBaudRate = baudRate;
+  NextBaudRate = 0;
+
+  // Initialises rings
+  Ring_Init(&RxRing);
 
   // Create semaphores
-  RxSemaphore = OS_SemaphoreCreate(0);
-  TxSemaphore = OS_SemaphoreCreate(0);
+  TxSpace = OS_SemaphoreCreate(0);
+  RxItems = OS_SemaphoreCreate(0);
+  for (TTxQueue* queue = TxQueue; queue < &TxQueue[UART_NB_CLASSES]; queue++)
+  {
+    queue->reserved = 0;
+    queue->released = 0;
+    queue->nbFrames = 0;
+    queue->limit = 0;
+  }
+  ResetTxStats();
+  TxDMAQueue = NULL;
+  TxHold = bFALSE;
+  TxSpaceWaiters = 0;
+  RxItemsNeeded = 0;
+  NbInterrupts = 0;
+  NbRxBytes = 0;
+  NbRxOverruns = 0;
+  RxPosition = 0;
+  NbTxBytes = 0;
 
   // UART setup
   // Enable system clock gate for UART2
@@ -55,31 +493,15 @@ BOOL UART_Init(const uint32_t baudRate, const uint32_t moduleClk)
   // To turn Receiver Enable bit 2 (RE) off before setting baud rate
   UART2_C2 &= ~UART_C2_RE_MASK;
 
-  // Calculate variables to configure baud rate
-  sbr  = (uint16_t)(moduleClk / (16 * baudRate));
-  // Calculate the baud rate fine adjust
-  brfa = 2 * (moduleClk / baudRate) - 32 * sbr;
-
-  // Because ((2^13)-1) didn't work, wanted to indicate maximum is limit of 13 bit unsigned number
-  if(sbr > 8191)
-  {
-    // Baud rate is too low, meaning unsigned 13 bit SBR limit is exceeded, UART_Init fails
+  // The fine adjust gives the baud rate to 1/32 of the divisor
+  if (!Divisor(baudRate, &divisor, &error))
     return bFALSE;
-  }
-  else
-  {
-    // Reset register (debugging step), we may assume TE and RE bits are turned off)
-    UART2_BDL = 0x0;
-    // 'hi' because register has been reset, and prior error checking ensures UART baud rate bits 4:0 (SBR) will only be written to
-    UART2_BDH = UART2_BDH | (sbr >> 8);
-    // Because setting an 8 bit register
-    UART2_BDL = UART2_BDL | ( (uint8_t)(sbr & 0xFF));
-  }
+  SetDivisor(divisor);
 
   // C1 control registers
   UART2_C1 &= ~UART_C1_PT_MASK;         // Disabled
   UART2_C1 &= ~UART_C1_PE_MASK;         // Disabled
-  UART2_C1 &= ~UART_C1_ILT_MASK;        // Disabled
+  UART2_C1 |= UART_C1_ILT_MASK;         // Idle line counted from the stop bit, so it marks the end of a burst
   UART2_C1 &= ~UART_C1_WAKE_MASK;       // Disabled
   UART2_C1 &= ~UART_C1_M_MASK;          // Disabled
   UART2_C1 &= ~UART_C1_RSRC_MASK;       // Disabled
@@ -89,16 +511,61 @@ BOOL UART_Init(const uint32_t baudRate, const uint32_t moduleClk)
   // C2 control registers
   UART2_C2 &= ~UART_C2_SBK_MASK;        // Disabled
   UART2_C2 &= ~UART_C2_RWU_MASK;        // Disabled
-  UART2_C2 &= ~UART_C2_ILIE_MASK;       // Disabled
-  UART2_C2 &= ~UART_C2_TIE_MASK;        // Disabled
+
+  // FIFOs can only be enabled while the transmitter and receiver are off
+  TxFifoDepth = FifoDepth((UART2_PFIFO & UART_PFIFO_TXFIFOSIZE_MASK) >> UART_PFIFO_TXFIFOSIZE_SHIFT);
+  RxFifoDepth = FifoDepth((UART2_PFIFO & UART_PFIFO_RXFIFOSIZE_MASK) >> UART_PFIFO_RXFIFOSIZE_SHIFT);
+  UART2_PFIFO |= UART_PFIFO_TXFE_MASK | UART_PFIFO_RXFE_MASK;
+  UART2_CFIFO |= UART_CFIFO_TXFLUSH_MASK | UART_CFIFO_RXFLUSH_MASK;
+  (void)UART_SetWatermarks(TxFifoDepth / 4, 1);
+
+  // Enable system clock gates for the DMA and its request multiplexer
+  SIM_SCGC6 |= SIM_SCGC6_DMAMUX0_MASK;
+  SIM_SCGC7 |= SIM_SCGC7_DMA_MASK;
+
+  // The receive DMA writes round the receive ring for ever, interrupting at each half
+  DMAMUX0_CHCFG0 = 0;
+  DMA_TCD0_SADDR = (uint32_t)&UART2_D;
+  DMA_TCD0_SOFF = 0;
+  DMA_TCD0_ATTR = DMA_ATTR_SSIZE(0) | DMA_ATTR_DSIZE(0);
+  DMA_TCD0_NBYTES_MLNO = 1;
+  DMA_TCD0_SLAST = 0;
+  DMA_TCD0_DADDR = (uint32_t)RxRing.Buffer;
+  DMA_TCD0_DOFF = 1;
+  DMA_TCD0_CITER_ELINKNO = DMA_CITER_ELINKNO_CITER(RING_SIZE);
+  DMA_TCD0_BITER_ELINKNO = DMA_BITER_ELINKNO_BITER(RING_SIZE);
+  DMA_TCD0_DLASTSGA = (uint32_t)(-RING_SIZE);
+  DMA_TCD0_CSR = DMA_CSR_INTHALF_MASK | DMA_CSR_INTMAJOR_MASK;
+  DMAMUX0_CHCFG0 = DMAMUX_CHCFG_ENBL_MASK | DMAMUX_CHCFG_SOURCE(UART2_RX_DMA_SOURCE);
+  DMA_SERQ = DMA_SERQ_SERQ(UART_RX_DMA_CHANNEL);
+
+  // The transmit DMA sends one piece of the transmit ring, then stops and interrupts
+  DMAMUX0_CHCFG1 = 0;
+  DMA_TCD1_SOFF = 1;
+  DMA_TCD1_ATTR = DMA_ATTR_SSIZE(0) | DMA_ATTR_DSIZE(0);
+  DMA_TCD1_NBYTES_MLNO = 1;
+  DMA_TCD1_SLAST = 0;
+  DMA_TCD1_DADDR = (uint32_t)&UART2_D;
+  DMA_TCD1_DOFF = 0;
+  DMA_TCD1_DLASTSGA = 0;
+  DMA_TCD1_CSR = DMA_CSR_INTMAJOR_MASK | DMA_CSR_DREQ_MASK;
+  DMAMUX0_CHCFG1 = DMAMUX_CHCFG_ENBL_MASK | DMAMUX_CHCFG_SOURCE(UART2_TX_DMA_SOURCE);
+
+  // RDRF and TDRE request DMA transfers instead of interrupts
+  UART2_C5 |= UART_C5_RDMAS_MASK;
+  UART2_C5 |= UART_C5_TDMAS_MASK;
 
   // Enable interrupts
-  UART2_C2 |= UART_C2_TCIE_MASK;       	// Disabled
-  UART2_C2 |= UART_C2_RIE_MASK;         // Enable receive (RDRF) interrupt
+  UART2_C2 &= ~UART_C2_TCIE_MASK;       // Disabled
+  UART2_C2 |= UART_C2_RIE_MASK;         // Enable receive (RDRF) DMA request
+  UART2_C2 |= UART_C2_TIE_MASK;         // Enable transmit (TDRE) DMA request, serviced only while a transfer is set up
+  UART2_C2 |= UART_C2_ILIE_MASK;        // Enable idle line interrupt, to mark the end of a burst
 
   // NVIC Register Mask
   NVICICPR1 = (1<<(49 % 32));		// Clear any pending error status sources interrupts on UART2
   NVICISER1 = (1<<(49 % 32));		// Enable error status sources interrupts from UART2
+  NVICICPR0 = (1<<0) | (1<<1);		// Clear any pending interrupts on DMA channels 0 and 1
+  NVICISER0 = (1<<0) | (1<<1);		// Enable interrupts from DMA channels 0 and 1
 
   // UART receive and transmit
   UART2_C2 |= UART_C2_RE_MASK;          // Enable UART2 receive
@@ -114,7 +581,7 @@ BOOL UART_Init(const uint32_t baudRate, const uint32_t moduleClk)
  */
 void UART_InChar(uint8_t * const dataPtr)
 {
-  FIFO_Get(&RxFIFO, dataPtr);
+  UART_InBlock(dataPtr, 1);
 }
 
 /*! @brief Put a byte in the transmit FIFO if it is not full.
@@ -124,46 +591,299 @@ void UART_InChar(uint8_t * const dataPtr)
  */
 void UART_OutChar(const uint8_t data)
 {
-  FIFO_Put(&TxFIFO, data);
+  UART_OutBlock(&data, 1);
 }
 
-/*! @brief UART transmit thread
+/*! @brief Get a block of bytes from the receive FIFO, waiting until they have all arrived.
  *
- *  @return void
+ *  @param data A pointer to memory to store the retrieved bytes.
+ *  @param length The number of bytes to retrieve.
+ *  @return void.
  */
-void TxThread(void* arg)
+void UART_InBlock(uint8_t data[], const uint16_t length)
 {
-  uint8_t txData;
+  uint16_t done = 0, needed;
 
+  // The ISRs are the only producer and the caller the only consumer
   for (;;)
   {
-    // Semaphore to wait for the transmit
-    OS_SemaphoreWait (TxSemaphore, 0);
-    // Put data in the UART2_D register
-    FIFO_Get(&TxFIFO, &txData);
-    UART2_D = txData;
-    UART2_C2 |= UART_C2_TCIE_MASK;
+    done += Ring_GetBlock(&RxRing, &data[done], length - done);
+    if (done == length)
+      return;
+
+    // Sleep until the rest of the block, or a watermark's worth of it, has arrived
+    needed = length - done;
+    if (needed > UART_WATERMARK)
+      needed = UART_WATERMARK;
+    (void)Wait(&RxRing, needed, RxItems, &RxItemsNeeded, 0);
   }
 }
 
-/*! @brief UART receive thread
+/*! @brief Waits until the receive ring holds at least a number of bytes.
  *
- *  @return void
+ *  @param length The number of bytes, at most UART_WATERMARK.
+ *  @param timeout The number of clock ticks to wait, 0 to wait forever.
+ *  @return BOOL - TRUE if the bytes have arrived, FALSE if the wait timed out.
+ *  @note Bytes are published when the line goes idle or the DMA fills half the ring.
  */
-void RxThread(void* arg)
+BOOL UART_InWait(const uint16_t length, const uint32_t timeout)
 {
+  return Wait(&RxRing, length, RxItems, &RxItemsNeeded, timeout);
+}
+
+/*! @brief Gets the number of received bytes waiting to be taken.
+ *
+ *  @return uint16_t - The number of bytes.
+ */
+uint16_t UART_InCount(void)
+{
+  return Ring_Count(&RxRing);
+}
+
+/*! @brief Reads a received byte where the DMA left it, without taking it.
+ *
+ *  @param offset The position of the byte after the oldest one, less than the number waited for.
+ *  @return uint8_t - The byte.
+ */
+uint8_t UART_InPeek(const uint16_t offset)
+{
+  return Ring_Peek(&RxRing, offset);
+}
+
+/*! @brief Takes received bytes without copying them.
+ *
+ *  @param length The number of bytes to take, no more than the number waited for.
+ *  @return void.
+ */
+void UART_InSkip(const uint16_t length)
+{
+  Ring_Skip(&RxRing, length);
+}
+
+/*! @brief Reserves space in the transmit buffer for a frame.
+ *
+ *  The caller writes the frame in place and then passes it to UART_OutCommit. Frames are sent
+ *  whole, control frames ahead of telemetry, and each class in the order it was reserved.
+ *  @param length The number of bytes in the frame, 1 to UART_FRAME_MAX.
+ *  @param class The transmit class of the frame.
+ *  @return uint8_t* - Where to write the frame, or NULL if the length or class is not valid.
+ *  @note Waits while the class's buffer is full, unless it drops its oldest frames, so it must not be called from an ISR.
+ */
+uint8_t* UART_OutReserve(const uint16_t length, const TUARTClass class)
+{
+  TFrameHeader* header;
+
+  if ((length == 0) || (length > UART_FRAME_MAX) || (class >= UART_NB_CLASSES))
+    return NULL;
+
   for (;;)
   {
-    // Semaphore to wait for the receive
-    OS_SemaphoreWait(RxSemaphore, 0);
-    // Puts bytes UART2_D register upon receive
-    FIFO_Put(&RxFIFO, UART2_D);
-    UART2_C2 |= UART_C2_RIE_MASK;
+    // Only the reservation itself is a critical section, the frame is written with interrupts enabled
+    OS_DisableInterrupts();
+    header = Allocate(&TxQueue[class], length);
+    if (!header)
+      TxSpaceWaiters++;
+    OS_EnableInterrupts();
+
+    if (header)
+      return (uint8_t*)(header + 1);
+
+    // Every waiter is woken when a frame is released, and tries again
+    (void)OS_SemaphoreWait(TxSpace, 0);
   }
 }
 
+/*! @brief Queues a reserved frame for transmission.
+ *
+ *  @param frame The frame returned by UART_OutReserve, now written.
+ *  @return void.
+ */
+void UART_OutCommit(uint8_t* const frame)
+{
+  TFrameHeader* header = (TFrameHeader*)frame - 1;
+
+  header->time = OS_TimeGet();
+  header->committed = 1;
+
+  // Start the DMA unless it is already sending, in which case its ISR moves on to this frame
+  OS_DisableInterrupts();
+  TxStart();
+  OS_EnableInterrupts();
+}
+
+/*! @brief Put a block of bytes in the transmit FIFO in one piece.
+ *
+ *  @param data The bytes to be placed in the transmit FIFO.
+ *  @param length The number of bytes to transmit.
+ *  @return void.
+ *  @note Only blocks of up to UART_FRAME_MAX bytes are kept in one piece.
+ */
+void UART_OutBlock(const uint8_t data[], const uint16_t length)
+{
+  uint16_t done = 0, piece;
+  uint8_t* frame;
+
+  while (done < length)
+  {
+    piece = length - done;
+    if (piece > UART_FRAME_MAX)
+      piece = UART_FRAME_MAX;
+
+    frame = UART_OutReserve(piece, UART_CLASS_CONTROL);
+    for (uint16_t byte = 0; byte < piece; byte++)
+      frame[byte] = data[done + byte];
+    UART_OutCommit(frame);
+    done += piece;
+  }
+}
+
+/*! @brief Sets the levels at which the FIFOs interrupt.
+ *
+ *  @param txWatermark The transmit FIFO interrupts once it holds this many bytes or fewer.
+ *  @param rxWatermark The receive FIFO interrupts once it holds this many bytes or more.
+ *  @return BOOL - TRUE if the watermarks fit the FIFOs.
+ *  @note The receive watermark must be 1, as the receive DMA moves one byte per request.
+ */
+BOOL UART_SetWatermarks(const uint8_t txWatermark, const uint8_t rxWatermark)
+{
+  // The receive DMA moves one byte per request, so it would stall with bytes left below a higher watermark
+  if ((txWatermark >= TxFifoDepth) || (rxWatermark != 1))
+    return bFALSE;
+
+  UART2_TWFIFO = UART_TWFIFO_TXWATER(txWatermark);
+  UART2_RWFIFO = UART_RWFIFO_RXWATER(rxWatermark);
+
+  return bTRUE;
+}
+
+/*! @brief Switches to a negotiated baud rate once its acknowledgement has been sent.
+ *
+ *  @return uint32_t - The clock ticks to wait for a valid packet at the new rate, 0 if there was no switch.
+ *  @note Called by the packet thread after each packet has been handled and acknowledged.
+ */
+uint32_t UART_BaudUpdate(void)
+{
+  uint32_t baudRate = NextBaudRate;
+
+  if (baudRate == 0)
+    return 0;
+
+  NextBaudRate = 0;
+  if (!SwitchBaudRate(baudRate) || (baudRate == InitBaudRate))
+    return 0;
+
+  return UART_BAUD_TIMEOUT;
+}
+
+/*! @brief Falls back to the baud rate set by UART_Init.
+ *
+ *  @return void.
+ *  @note Called by the packet thread when no valid packet arrives in time after a switch.
+ */
+void UART_BaudFallback(void)
+{
+  (void)SwitchBaudRate(InitBaudRate);
+}
+
+/*! @brief Sets the FIFO watermarks, negotiates the baud rate or reports the interrupt counters.
+ *
+ *  @param control The UART control command.
+ *  @param data The data sent with the command.
+ *  @return BOOL - TRUE if the command was valid.
+ */
+BOOL UART_Control(const TUARTControl control, const uint16union_t data)
+{
+  BOOL valid;
+  uint32_t divisor;
+  int32_t error;
+  TTxQueue* queue;
+
+  switch (control)
+  {
+    case UART_STATUS_CHECK:
+      valid = (data.l == 0);
+      if (!valid)
+        break;
+      Packet_Put(UART_COMMAND, UART_STATUS_CHECK, TxFifoDepth, RxFifoDepth);
+      Packet_Put(UART_COMMAND, UART_TX_WATERMARK, UART2_TWFIFO, 0);
+      Packet_Put(UART_COMMAND, UART_RX_WATERMARK, UART2_RWFIFO, 0);
+      Packet_Put(UART_COMMAND, UART_INTERRUPTS_LO, (uint8_t)NbInterrupts, (uint8_t)(NbInterrupts >> 8));
+      Packet_Put(UART_COMMAND, UART_INTERRUPTS_HI, (uint8_t)(NbInterrupts >> 16), (uint8_t)(NbInterrupts >> 24));
+      Packet_Put(UART_COMMAND, UART_RX_BYTES_LO, (uint8_t)NbRxBytes, (uint8_t)(NbRxBytes >> 8));
+      Packet_Put(UART_COMMAND, UART_RX_BYTES_HI, (uint8_t)(NbRxBytes >> 16), (uint8_t)(NbRxBytes >> 24));
+      Packet_Put(UART_COMMAND, UART_TX_BYTES_LO, (uint8_t)NbTxBytes, (uint8_t)(NbTxBytes >> 8));
+      Packet_Put(UART_COMMAND, UART_TX_BYTES_HI, (uint8_t)(NbTxBytes >> 16), (uint8_t)(NbTxBytes >> 24));
+      Packet_Put(UART_COMMAND, UART_RX_OVERRUNS_LO, (uint8_t)NbRxOverruns, (uint8_t)(NbRxOverruns >> 8));
+      Packet_Put(UART_COMMAND, UART_RX_OVERRUNS_HI, (uint8_t)(NbRxOverruns >> 16), (uint8_t)(NbRxOverruns >> 24));
+      break;
+
+    case UART_TX_WATERMARK:
+      valid = (data.s.Hi == 0) && UART_SetWatermarks(data.s.Lo, UART2_RWFIFO);
+      break;
+
+    case UART_RX_WATERMARK:
+      valid = (data.s.Hi == 0) && UART_SetWatermarks(UART2_TWFIFO, data.s.Lo);
+      break;
+
+    // The baud rate is sent in hundreds of bits/sec, so 1.5 Mbit/s fits in 16 bits
+    case UART_BAUD_PROPOSE:
+      valid = Divisor((uint32_t)data.l * 100, &divisor, &error);
+      if (!valid)
+        break;
+      Packet_Put(UART_COMMAND, UART_BAUD_PROPOSE, (uint8_t)error, (uint8_t)(error >> 8));
+      break;
+
+    case UART_BAUD_SWITCH:
+      valid = Divisor((uint32_t)data.l * 100, &divisor, &error);
+      if (!valid)
+        break;
+      NextBaudRate = (uint32_t)data.l * 100;
+      break;
+
+    case UART_STATS_RESET:
+      valid = (data.l == 0);
+      if (!valid)
+        break;
+      OS_DisableInterrupts();
+      NbInterrupts = 0;
+      NbRxBytes = 0;
+      NbRxOverruns = 0;
+      NbTxBytes = 0;
+      ResetTxStats();
+      OS_EnableInterrupts();
+      break;
+
+    case UART_TELEMETRY_LIMIT:
+      valid = (data.l < (UART_TX_SIZE / sizeof(TFrameHeader)));
+      if (!valid)
+        break;
+      TxQueue[UART_CLASS_TELEMETRY].limit = data.l;
+      break;
+
+    // Latencies are in OS clock ticks from commit to the start of transmission
+    case UART_CLASS_STATS:
+      valid = (data.l < UART_NB_CLASSES);
+      if (!valid)
+        break;
+      queue = &TxQueue[data.l];
+      Packet_Put(UART_COMMAND, UART_CLASS_DEPTH, (uint8_t)queue->nbFrames, (uint8_t)queue->maxFrames);
+      Packet_Put(UART_COMMAND, UART_CLASS_LATENCY, (uint8_t)(queue->nbSent ? queue->latencySum / queue->nbSent : 0),
+		 (uint8_t)((queue->nbSent ? queue->latencySum / queue->nbSent : 0) >> 8));
+      Packet_Put(UART_COMMAND, UART_CLASS_LATENCY_MAX, (uint8_t)queue->latencyMax, (uint8_t)(queue->latencyMax >> 8));
+      Packet_Put(UART_COMMAND, UART_CLASS_DROPPED, (uint8_t)queue->nbDropped, (uint8_t)(queue->nbDropped >> 8));
+      break;
+
+    default:
+      valid = bFALSE;
+      break;
+  }
+
+  return valid;
+}
+
 /*! @brief Interrupt service routine for UART2
  *
+ *  Publishes the end of a burst to the receive ring when the line goes idle.
  *  @return void
  *  @note vectors.c updated
  */
@@ -171,30 +891,62 @@ void __attribute__ ((interrupt)) UART_ISR(void)
 {
   OS_ISREnter();
 
-  // Receive a character
-  if (UART2_C2 & UART_C2_RIE_MASK)
+  NbInterrupts++;
+
+  if (UART2_S1 & UART_S1_IDLE_MASK)
   {
-    // Clear RDRF flag by reading the status register
-    if (UART2_S1 & UART_S1_RDRF_MASK)
+    // IDLE is cleared by reading the data register after the status register, which must wait until
+    // the DMA has emptied the FIFO. No new byte can complete for a character time after the line
+    // goes idle, so the read finds the FIFO empty and only flags an underflow.
+    if (UART2_RCFIFO == 0)
     {
-      // Semaphore signals the receive
-      OS_SemaphoreSignal(RxSemaphore);
-      // Disable RIE after bytes have been received
-      UART2_C2 &= ~UART_C2_RIE_MASK;
+      (void)UART2_D;
+      if (UART2_SFIFO & UART_SFIFO_RXUF_MASK)
+      {
+        UART2_CFIFO |= UART_CFIFO_RXFLUSH_MASK;
+        UART2_SFIFO = UART_SFIFO_RXUF_MASK;
+      }
     }
+    RxSync();
   }
 
-  // Transmit a character
-  if (UART2_C2 & UART_C2_TCIE_MASK)
+  OS_ISRExit();
+}
+
+/*! @brief Interrupt service routine for the UART2 DMA channels
+ *
+ *  Publishes received bytes each time the receive DMA fills half the ring, and moves the
+ *  transmit DMA on to the next frame.
+ *  @return void
+ *  @note vectors.c updated
+ */
+void __attribute__ ((interrupt)) UART_DMAISR(void)
+{
+  TFrameHeader* header;
+
+  OS_ISREnter();
+
+  NbInterrupts++;
+
+  if (DMA_INT & (1 << UART_RX_DMA_CHANNEL))
   {
-    // Clear TDRE flag by reading the status register
-    if (UART2_S1 & UART_S1_TC_MASK)
-    {
-      // Semaphore signals the receive
-      OS_SemaphoreSignal(TxSemaphore);
-      // Disable TCIE after bytes have been transmitted
-      UART2_C2 &= ~UART_C2_TCIE_MASK;
-    }
+    DMA_CINT = DMA_CINT_CINT(UART_RX_DMA_CHANNEL);
+    RxSync();
+  }
+
+  if (DMA_INT & (1 << UART_TX_DMA_CHANNEL))
+  {
+    DMA_CINT = DMA_CINT_CINT(UART_TX_DMA_CHANNEL);
+    header = Record(TxDMAQueue, TxDMAQueue->released);
+    NbTxBytes += header->length;
+    TxDMAQueue->nbSent++;
+    TxDMAQueue->nbFrames--;
+    TxDMAQueue->released += header->size;
+    TxDMAQueue = NULL;
+    TxStart();
+
+    for (; TxSpaceWaiters; TxSpaceWaiters--)
+      (void)OS_SemaphoreSignal(TxSpace);
   }
 
   OS_ISRExit();
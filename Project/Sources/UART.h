@@ -13,17 +13,56 @@
 #include "OS.h"
 #include "types.h"
 
-// UART semaphores
-OS_ECB *RxSemaphore;
-OS_ECB *TxSemaphore;
+// Packet command for the FIFO watermarks, baud rate and interrupt counters
+#define UART_COMMAND 0x62
+// The most bytes in one transmit frame
+#define UART_FRAME_MAX 320
+// Clock ticks to wait for a valid packet at a new baud rate before falling back
+#define UART_BAUD_TIMEOUT 1000
+
+typedef enum
+{
+  UART_STATUS_CHECK	= 0,
+  UART_TX_WATERMARK	= 1,
+  UART_RX_WATERMARK	= 2,
+  UART_STATS_RESET	= 3,
+  UART_INTERRUPTS_LO	= 4,
+  UART_INTERRUPTS_HI	= 5,
+  UART_RX_BYTES_LO	= 6,
+  UART_RX_BYTES_HI	= 7,
+  UART_TX_BYTES_LO	= 8,
+  UART_TX_BYTES_HI	= 9,
+  UART_BAUD_PROPOSE	= 10,
+  UART_BAUD_SWITCH	= 11,
+  UART_TELEMETRY_LIMIT	= 12,
+  UART_CLASS_STATS	= 13,
+  UART_CLASS_DEPTH	= 14,
+  UART_CLASS_LATENCY	= 15,
+  UART_CLASS_LATENCY_MAX	= 16,
+  UART_CLASS_DROPPED	= 17,
+  UART_RX_OVERRUNS_LO	= 18,
+  UART_RX_OVERRUNS_HI	= 19
+}TUARTControl;
+
+// Number of transmit classes
+#define UART_NB_CLASSES 2
+
+typedef enum
+{
+  UART_CLASS_CONTROL	= 0,
+  UART_CLASS_TELEMETRY	= 1
+}TUARTClass;
 
 /*! @brief Sets up the UART interface before first use.
  *
  *  @param baudRate The desired baud rate in bits/sec.
  *  @param moduleClk The module clock rate in Hz
+ *  @param userFunction is a pointer to a user callback function called from the ISRs whenever received bytes arrive, or NULL.
+ *  @param userArguments is a pointer to the user arguments to use with the user callback function.
  *  @return BOOL - TRUE if the UART was successfully initialized.
+ *  @note A callback becomes the only consumer of the received bytes, so UART_InBlock and UART_InWait must not be used with it.
  */
-BOOL UART_Init(const uint32_t baudRate, const uint32_t moduleClk);
+BOOL UART_Init(const uint32_t baudRate, const uint32_t moduleClk, void (*userFunction)(void*), void* userArguments);
  
 /*! @brief Get a character from the receive FIFO if it is not empty.
  *
@@ -39,23 +78,116 @@ void UART_InChar(uint8_t * const dataPtr);
  */
 void UART_OutChar(const uint8_t data);
 
-/*! @brief UART transmit thread
+/*! @brief Get a block of bytes from the receive FIFO, waiting until they have all arrived.
  *
- *  @return void
+ *  @param data A pointer to memory to store the retrieved bytes.
+ *  @param length The number of bytes to retrieve.
+ *  @return void.
  */
-void TxThread(void* arg);
+void UART_InBlock(uint8_t data[], const uint16_t length);
 
-/*! @brief UART receive thread
+/*! @brief Waits until the receive ring holds at least a number of bytes.
  *
- *  @return void
+ *  @param length The number of bytes, at most half the ring.
+ *  @param timeout The number of clock ticks to wait, 0 to wait forever.
+ *  @return BOOL - TRUE if the bytes have arrived, FALSE if the wait timed out.
+ *  @note Bytes are published when the line goes idle or the DMA fills half the ring.
+ */
+BOOL UART_InWait(const uint16_t length, const uint32_t timeout);
+
+/*! @brief Gets the number of received bytes waiting to be taken.
+ *
+ *  @return uint16_t - The number of bytes.
+ */
+uint16_t UART_InCount(void);
+
+/*! @brief Reads a received byte where the DMA left it, without taking it.
+ *
+ *  @param offset The position of the byte after the oldest one, less than the number waited for.
+ *  @return uint8_t - The byte.
+ */
+uint8_t UART_InPeek(const uint16_t offset);
+
+/*! @brief Takes received bytes without copying them.
+ *
+ *  @param length The number of bytes to take, no more than the number waited for.
+ *  @return void.
+ */
+void UART_InSkip(const uint16_t length);
+
+/*! @brief Reserves space in the transmit buffer for a frame.
+ *
+ *  The caller writes the frame in place and then passes it to UART_OutCommit. Frames are sent
+ *  whole, control frames ahead of telemetry, and each class in the order it was reserved.
+ *  @param length The number of bytes in the frame, 1 to UART_FRAME_MAX.
+ *  @param class The transmit class of the frame.
+ *  @return uint8_t* - Where to write the frame, or NULL if the length or class is not valid.
+ *  @note Waits while the class's buffer is full, unless it drops its oldest frames, so it must not be called from an ISR.
+ */
+uint8_t* UART_OutReserve(const uint16_t length, const TUARTClass class);
+
+/*! @brief Queues a reserved frame for transmission.
+ *
+ *  @param frame The frame returned by UART_OutReserve, now written.
+ *  @return void.
  */
-void RxThread(void* arg);
+void UART_OutCommit(uint8_t* const frame);
+
+/*! @brief Put a block of bytes in the transmit FIFO in one piece.
+ *
+ *  @param data The bytes to be placed in the transmit FIFO.
+ *  @param length The number of bytes to transmit.
+ *  @return void.
+ *  @note Only blocks of up to UART_FRAME_MAX bytes are kept in one piece.
+ */
+void UART_OutBlock(const uint8_t data[], const uint16_t length);
+
+/*! @brief Sets the levels at which the FIFOs interrupt.
+ *
+ *  @param txWatermark The transmit FIFO interrupts once it holds this many bytes or fewer.
+ *  @param rxWatermark The receive FIFO interrupts once it holds this many bytes or more.
+ *  @return BOOL - TRUE if the watermarks fit the FIFOs.
+ *  @note The receive watermark must be 1, as the receive DMA moves one byte per request.
+ */
+BOOL UART_SetWatermarks(const uint8_t txWatermark, const uint8_t rxWatermark);
+
+/*! @brief Switches to a negotiated baud rate once its acknowledgement has been sent.
+ *
+ *  @return uint32_t - The clock ticks to wait for a valid packet at the new rate, 0 if there was no switch.
+ *  @note Called by the packet thread after each packet has been handled and acknowledged.
+ */
+uint32_t UART_BaudUpdate(void);
+
+/*! @brief Falls back to the baud rate set by UART_Init.
+ *
+ *  @return void.
+ *  @note Called by the packet thread when no valid packet arrives in time after a switch.
+ */
+void UART_BaudFallback(void);
+
+/*! @brief Sets the FIFO watermarks, negotiates the baud rate or reports the interrupt counters.
+ *
+ *  @param control The UART control command.
+ *  @param data The data sent with the command.
+ *  @return BOOL - TRUE if the command was valid.
+ */
+BOOL UART_Control(const TUARTControl control, const uint16union_t data);
 
 /*! @brief Interrupt service routine for UART2
  *
+ *  Publishes the end of a burst to the receive ring when the line goes idle.
  *  @return void
  *  @note vectors.c updated
  */
 void __attribute__ ((interrupt)) UART_ISR(void);
 
+/*! @brief Interrupt service routine for the UART2 DMA channels
+ *
+ *  Publishes received bytes each time the receive DMA fills half the ring, and moves the
+ *  transmit DMA on to the next frame.
+ *  @return void
+ *  @note vectors.c updated
+ */
+void __attribute__ ((interrupt)) UART_DMAISR(void);
+
 #endif
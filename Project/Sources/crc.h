@@ -0,0 +1,44 @@
+/*! @file
+ *
+ *  @brief Routines for the 16-bit CRC used by the extended packet frames.
+ *
+ *  This contains the functions for computing a CRC-16/CCITT (polynomial 0x1021, seed 0xFFFF,
+ *  no reflection and no final XOR) over a block with the K70 CRC module, or byte by byte from a table.
+ *
+ *  @author Mohammad Yasin Azimi
+ *  @date 2016-11-09
+ */
+#ifndef CRC_H
+#define CRC_H
+
+// new types
+#include "types.h"
+
+// The CRC of an empty block
+#define CRC_SEED 0xFFFF
+
+/*! @brief Sets up the CRC module before first use.
+ *
+ *  @return BOOL - TRUE if the CRC module was successfully initialized.
+ */
+BOOL CRC_Init(void);
+
+/*! @brief Adds one byte to a running CRC.
+ *
+ *  @param crc The CRC of the bytes so far, CRC_SEED to start.
+ *  @param data The next byte.
+ *  @return uint16_t - The CRC including the byte.
+ *  @note Table driven, so it is safe to call from an ISR.
+ */
+uint16_t CRC_Update(const uint16_t crc, const uint8_t data);
+
+/*! @brief Computes the CRC of a block.
+ *
+ *  @param data The bytes.
+ *  @param length The number of bytes.
+ *  @return uint16_t - The CRC of the block.
+ *  @note Uses the CRC module on the K70, so it must not be called from an ISR. Elsewhere it falls back to the table.
+ */
+uint16_t CRC_Block(const uint8_t data[], const uint16_t length);
+
+#endif
@@ -36,14 +36,17 @@
 #include "packet.h"
 #include "analog.h"
 #include "waveform.h"
+#include "sequence.h"
+#include "trigger.h"
 
 #define NB_AWG_CHANNELS 2
 #define PIT_PERIOD 10000000
 #define STARTUP_COMMAND 0x60
 #define THREAD_STACK_SIZE 100
-#define PROTOCOL_FREQUENCY_OUTPUT 256
+#define PROTOCOL_FREQUENCY_OUTPUT 65536
 #define PROTOCOL_AMPLITUDE_OUTPUT 3276
 #define PROTOCOL_OFFSET_OUTPUT 0
+#define PROTOCOL_DUTY_OUTPUT 32768
 
 
 // Function Prototypes
@@ -52,21 +55,21 @@ static void InitThread(void* arg);
 static void PacketThread(void* arg);
 void Channel_Init(const uint16_t sampleFrequency, const uint32_t moduleClk);
 BOOL Channel_Control(const TFGControl control, const uint16union_t data);
+static BOOL SequenceCommand(const TSequenceControl control, const uint16union_t data);
+static void TriggerCallback(void* arg);
 
 static uint32_t BaudRate = 115200;		/*!< Baud rate for the tower */
 static uint16_t SampleFrequency = 100;		/*!< Sample frequency for the waveform period */
-static uint16_t SampleNb;			/*!< Number of samples per period */
-static uint16_t SampleNbMax;			/*!< The maximum limit of the sample number */
 static uint8_t CurrentChannel;			/*!< The channel currently being used */
+static uint16_t FrequencyLo[NB_AWG_CHANNELS];	/*!< The low half of each channel's 32-bit frequency waiting for its high half */
 TChannel Channel[NB_AWG_CHANNELS];		/*!< Number of digital output channels */
+static TSequence Sequence[NB_AWG_CHANNELS];	/*!< The segment sequence played on each channel */
 volatile uint16union_t *NvTowerNumber, *NvTowerMode;
 
 // Thread stacks
 static uint32_t PITThreadStack[THREAD_STACK_SIZE]    __attribute__ ((aligned(0x08)));	/*!< The stack for the PIT thread */
 static uint32_t InitThreadStack[THREAD_STACK_SIZE]   __attribute__ ((aligned(0x08)));	/*!< The stack for the Tower Init thread */
 static uint32_t PacketThreadStack[THREAD_STACK_SIZE] __attribute__ ((aligned(0x08)));	/*!< The stack for the Packet thread */
-static uint32_t RxThreadStack[THREAD_STACK_SIZE]     __attribute__ ((aligned(0x08)));	/*!< The stack for the UART receive thread */
-static uint32_t TxThreadStack[THREAD_STACK_SIZE]     __attribute__ ((aligned(0x08)));	/*!< The stack for the UART transmit thread */
 
 // Global semaphores
 extern OS_ECB* PITSemaphore;
@@ -94,14 +97,6 @@ int main(void)
 			NULL,
 			&InitThreadStack[THREAD_STACK_SIZE - 1],
 			0);
-  (void)OS_ThreadCreate(RxThread,
-			NULL,
-			&RxThreadStack[THREAD_STACK_SIZE - 1],
-			1);
-  (void)OS_ThreadCreate(TxThread,
-			NULL,
-			&TxThreadStack[THREAD_STACK_SIZE - 1],
-			2);
   (void)OS_ThreadCreate(PacketThread,
 			NULL,
 			&PacketThreadStack[THREAD_STACK_SIZE - 1],
@@ -134,16 +129,43 @@ static void InitThread(void* arg)
 static void PacketThread(void* arg)
 {
   BOOL valid;
+  uint32_t timeout = 0;
 
   for(;;)
   {
-    Packet_Get();
+    // After a baud rate switch, the PC must send a valid packet at the new rate in time
+    if (!Packet_Get(timeout))
+    {
+      UART_BaudFallback();
+      timeout = 0;
+      continue;
+    }
+    // Extended frames carry bulk data and are not acknowledged
+    if (PacketFrame.length)
+    {
+      if (PacketFrame.type == PACKET_FRAME_ECHO)
+        (void)Packet_PutFrame(PacketFrame.type, PacketFrame.payload, PacketFrame.length);
+      timeout = UART_BaudUpdate();
+      continue;
+    }
     switch (Packet_Command & ~(PACKET_ACK_MASK))
     {
       // Sends 0x60 as the AWG startup command
       case STARTUP_COMMAND:
         valid = Channel_Control(Packet_Parameter1, (uint16union_t)Packet_Parameter23);
         break;
+      // Sends 0x61 to upload and play a segment sequence
+      case SEQUENCE_COMMAND:
+        valid = SequenceCommand(Packet_Parameter1, (uint16union_t)Packet_Parameter23);
+        break;
+      // Sends 0x62 to set the UART FIFO watermarks, negotiate the baud rate or read the interrupt counters
+      case UART_COMMAND:
+        valid = UART_Control(Packet_Parameter1, (uint16union_t)Packet_Parameter23);
+        break;
+      // Sends 0x63 to read the packet receive counters
+      case PACKET_STATS_COMMAND:
+        valid = (Packet_Parameter1 == 0) && Packet_Stats((uint16union_t)Packet_Parameter23);
+        break;
       default:
 	valid = bFALSE;
 	break;
@@ -156,6 +178,8 @@ static void PacketThread(void* arg)
       else
       Packet_Put (Packet_Command, Packet_Parameter1, Packet_Parameter2, Packet_Parameter3);
     }
+    // A negotiated baud rate takes effect once the acknowledgement has gone out at the old rate
+    timeout = UART_BaudUpdate();
   }
 }
 
@@ -172,24 +196,23 @@ static void PITThread(void* arg)
   for (;;)
   {
     OS_SemaphoreWait(PITSemaphore, 0);
-    SampleNb++;
-    SampleNb = SampleNb % SampleNbMax;
 
-    if (Channel[0].active)
-    {
-      // Change data on transmission
-      digitalData[0].l = AWG_Output(Channel[0].output, SampleNb);
-      // Transmit data to the digital output
-      Analog_Put(0, digitalData[0].l);
-      // Packet_Put(0x50, 0, data[0].s.Lo, data[0].s.Hi);
-    }
-    if (Channel[1].active)
+    // Picks up a trigger level that changed while the switch was bouncing
+    Trigger_Poll();
+
+    for (uint8_t channelNb = 0; channelNb < NB_AWG_CHANNELS; channelNb++)
     {
-      // Change data on transmission and increment the number of samples
-      digitalData[0].l = AWG_Output(Channel[1].output, SampleNb);
-      // Transmit data to the digital output
-      Analog_Put(1, digitalData[0].l);
-      // Packet_Put(0x50, 0, data[0].s.Lo, data[0].s.Hi);
+      // Segment changes land exactly on this sample boundary
+      if (Sequence[channelNb].running)
+        Channel[channelNb].active = Sequence_Step(&Sequence[channelNb], &Channel[channelNb]);
+
+      if (Channel[channelNb].active)
+      {
+        // Change data on transmission
+        digitalData[0].l = AWG_Update(&Channel[channelNb]);
+        // Transmit data to the digital output
+        Analog_Put(channelNb, digitalData[0].l);
+      }
     }
   }
 }
@@ -210,16 +233,40 @@ void Channel_Init(const uint16_t sampleFrequency, const uint32_t moduleClk)
   for (uint8_t channelNb = 0; channelNb < NB_AWG_CHANNELS; channelNb++)
   {
     Channel[channelNb].active                 	= bFALSE;
-    Channel[channelNb].output.waveformType    	= SINE_WAVE;
-    Channel[channelNb].output.frequency.l 	= PROTOCOL_FREQUENCY_OUTPUT;
-    Channel[channelNb].output.amplitude.l 	= PROTOCOL_AMPLITUDE_OUTPUT;
-    Channel[channelNb].output.offset.l    	= PROTOCOL_OFFSET_OUTPUT;
+    Channel[channelNb].settings.waveformType  	= SINE_WAVE;
+    Channel[channelNb].settings.frequency.l 	= PROTOCOL_FREQUENCY_OUTPUT;
+    Channel[channelNb].settings.amplitude.l 	= PROTOCOL_AMPLITUDE_OUTPUT;
+    Channel[channelNb].settings.offset.l    	= PROTOCOL_OFFSET_OUTPUT;
+    Channel[channelNb].settings.phaseIncrement	= AWG_PhaseIncrement(PROTOCOL_FREQUENCY_OUTPUT);
+    Channel[channelNb].settings.duty.l		= PROTOCOL_DUTY_OUTPUT;
+    Channel[channelNb].settings.dutyLimit	= (uint32_t)PROTOCOL_DUTY_OUTPUT << 16;
+    Channel[channelNb].buffer[0]		= Channel[channelNb].settings;
+    Channel[channelNb].output			= &Channel[channelNb].buffer[0];
+    Channel[channelNb].next			= NULL;
+    Channel[channelNb].hold			= bFALSE;
+    Channel[channelNb].periodSync		= bFALSE;
+    Channel[channelNb].wrapped			= bFALSE;
+    Channel[channelNb].periodPending		= bFALSE;
+    Channel[channelNb].nextAtPeriod		= bFALSE;
+    Channel[channelNb].phase			= 0;
+    Channel[channelNb].mode			= CONTINUOUS_MODE;
+    Channel[channelNb].nbCycles			= 1;
+    Channel[channelNb].cyclesLeft		= 0;
+    Channel[channelNb].running			= bFALSE;
+    Channel[channelNb].trigger			= bFALSE;
+    Channel[channelNb].gate			= bFALSE;
     ChannelOn[channelNb]                  	= OS_SemaphoreCreate(0);
+    Sequence_Init(&Sequence[channelNb]);
   }
 
-  SampleNb = 0;
   CurrentChannel = 0;
-  SampleNbMax = 10 * sampleFrequency;
+
+  // Edges on the trigger input start bursts and open or close the gate
+  (void)Trigger_Init(TriggerCallback, NULL);
+
+  // The gate follows the input's idle level until the first edge
+  for (uint8_t channelNb = 0; channelNb < NB_AWG_CHANNELS; channelNb++)
+    Channel[channelNb].gate = Trigger_Level();
 
   // Create threads
   (void)OS_ThreadCreate(PITThread,
@@ -237,9 +284,14 @@ void Channel_Init(const uint16_t sampleFrequency, const uint32_t moduleClk)
 BOOL Channel_Control(const TFGControl control, const uint16union_t data)
 {
   BOOL valid;
+  BOOL changed = bFALSE;
   TChannel* channel;
   channel = &Channel[CurrentChannel];
 
+  // A finished sequence leaves its last segment playing until the staged settings are published again
+  if (!channel->hold)
+    Sequence_Release(&Sequence[CurrentChannel], channel);
+
   switch (control)
   {
     case STATUS_CHECK:
@@ -247,38 +299,77 @@ BOOL Channel_Control(const TFGControl control, const uint16union_t data)
       if (!valid)
         break;
       Packet_Put(STARTUP_COMMAND, STATUS_CHECK, CurrentChannel, 0);
-      Packet_Put(STARTUP_COMMAND, WAVEFORM_CHANGE, channel->output.waveformType, 0);
-      Packet_Put(STARTUP_COMMAND, FREQUENCY_CHANGE, channel->output.frequency.s.Lo, channel->output.frequency.s.Hi);
-      Packet_Put(STARTUP_COMMAND, AMPLITUDE_CHANGE, channel->output.amplitude.s.Lo, channel->output.amplitude.s.Hi);
-      Packet_Put(STARTUP_COMMAND, OFFSET_CHANGE, channel->output.offset.s.Lo, channel->output.offset.s.Hi);
+      Packet_Put(STARTUP_COMMAND, WAVEFORM_CHANGE, channel->settings.waveformType, 0);
+      Packet_Put(STARTUP_COMMAND, FREQUENCY_CHANGE, (uint8_t)(channel->settings.frequency.l >> 8), (uint8_t)(channel->settings.frequency.l >> 16));
+      Packet_Put(STARTUP_COMMAND, FREQUENCY_LO, (uint8_t)channel->settings.frequency.s.Lo, (uint8_t)(channel->settings.frequency.s.Lo >> 8));
+      Packet_Put(STARTUP_COMMAND, FREQUENCY_HI, (uint8_t)channel->settings.frequency.s.Hi, (uint8_t)(channel->settings.frequency.s.Hi >> 8));
+      Packet_Put(STARTUP_COMMAND, AMPLITUDE_CHANGE, channel->settings.amplitude.s.Lo, channel->settings.amplitude.s.Hi);
+      Packet_Put(STARTUP_COMMAND, OFFSET_CHANGE, channel->settings.offset.s.Lo, channel->settings.offset.s.Hi);
+      Packet_Put(STARTUP_COMMAND, DUTY_CHANGE, channel->settings.duty.s.Lo, channel->settings.duty.s.Hi);
+      Packet_Put(STARTUP_COMMAND, MODE_CHANGE, channel->mode, 0);
+      Packet_Put(STARTUP_COMMAND, BURST_CHANGE, (uint8_t)channel->nbCycles, (uint8_t)(channel->nbCycles >> 8));
       break;
 
     case WAVEFORM_CHANGE:
-      valid = ((data.s.Lo <= ARBITRARY_WAVE) || (data.s.Hi == 0));
+      valid = ((data.s.Lo <= PULSE_WAVE) && (data.s.Hi == 0));
       if (!valid)
         break;
-      channel->output.waveformType = data.s.Lo;
+      channel->settings.waveformType = data.s.Lo;
+      changed = bTRUE;
       break;
 
     case FREQUENCY_CHANGE:
-      valid = (data.l <= (100 * 256));
+      // Legacy 8.8 fixed point frequency
+      valid = AWG_FrequencyValid((uint32_t)data.l << 8);
       if (!valid)
         break;
-      channel->output.frequency = data;
+      channel->settings.frequency.l = (uint32_t)data.l << 8;
+      channel->settings.phaseIncrement = AWG_PhaseIncrement(channel->settings.frequency.l);
+      changed = bTRUE;
+      break;
+
+    case FREQUENCY_LO:
+      // Held until the high half arrives, so a 32-bit frequency is applied in one step
+      valid = bTRUE;
+      FrequencyLo[CurrentChannel] = data.l;
+      break;
+
+    case FREQUENCY_HI:
+      valid = AWG_FrequencyValid(((uint32_t)data.l << 16) | FrequencyLo[CurrentChannel]);
+      if (!valid)
+        break;
+      channel->settings.frequency.s.Lo = FrequencyLo[CurrentChannel];
+      channel->settings.frequency.s.Hi = data.l;
+      channel->settings.phaseIncrement = AWG_PhaseIncrement(channel->settings.frequency.l);
+      changed = bTRUE;
       break;
 
     case AMPLITUDE_CHANGE:
       valid = (data.l <= 32767);
       if (!valid)
         break;
-      channel->output.amplitude = data;
+      channel->settings.amplitude = data;
+      changed = bTRUE;
+      break;
+
+    case DUTY_CHANGE:
+      // 0 and 0xFFFF would hold the output at one level
+      valid = ((data.l > 0) && (data.l < 0xFFFF));
+      if (!valid)
+        break;
+      channel->settings.duty = data;
+      channel->settings.dutyLimit = (uint32_t)data.l << 16;
+      // The duty cycle only changes between whole periods
+      channel->periodPending = bTRUE;
+      changed = bTRUE;
       break;
 
     case OFFSET_CHANGE:
       valid = (((int16_t)data.l <=  32767) && ((int16_t)data.l >= -32767));
       if (!valid)
         break;
-      channel->output.offset.l = (int16_t)data.l;
+      channel->settings.offset.l = (int16_t)data.l;
+      changed = bTRUE;
       break;
 
     case CHANNEL_START:
@@ -302,13 +393,102 @@ BOOL Channel_Control(const TFGControl control, const uint16union_t data)
       CurrentChannel = data.s.Lo;
       break;
 
+    case MODE_CHANGE:
+      valid = ((data.s.Hi == 0) && (data.s.Lo <= GATED_MODE));
+      if (!valid)
+        break;
+      channel->running = bFALSE;
+      channel->mode = data.s.Lo;
+      break;
+
+    case BURST_CHANGE:
+      valid = (data.l > 0);
+      if (!valid)
+        break;
+      channel->nbCycles = data.l;
+      break;
+
+    case CHANNEL_TRIGGER:
+      valid = (data.l == 0) && (channel->mode == BURST_MODE);
+      if (!valid)
+        break;
+      channel->trigger = bTRUE;
+      break;
+
+    case UPDATE_HOLD:
+      valid = (data.l == 0) && (!channel->hold);
+      if (!valid)
+        break;
+      channel->hold = bTRUE;
+      break;
+
+    case UPDATE_COMMIT:
+      valid = (data.l == 0) && (channel->hold);
+      if (!valid)
+        break;
+      channel->hold = bFALSE;
+      changed = bTRUE;
+      break;
+
+    case UPDATE_SYNC:
+      valid = (data.l <= 1);
+      if (!valid)
+        break;
+      channel->periodSync = (BOOL)data.l;
+      break;
+
     default:
       valid = bFALSE;
   }
 
+  // Staged changes reach the PIT thread together, unless more are still to come or a sequence is playing
+  if (valid && changed && !channel->hold && !Sequence[CurrentChannel].running)
+    AWG_Publish(channel);
+
+  return valid;
+}
+
+/*! @brief Passes a sequence command to the sequence of the current channel.
+ *
+ *  @param control The sequence control command.
+ *  @param data The data sent with the command.
+ *  @return BOOL - TRUE if the command was valid.
+ */
+static BOOL SequenceCommand(const TSequenceControl control, const uint16union_t data)
+{
+  BOOL valid;
+
+  valid = Sequence_Control(&Sequence[CurrentChannel], control, data);
+
+  // The channel is silenced when its sequence is stopped early, and goes back to its staged settings
+  if (valid && (control == SEQUENCE_STOP))
+  {
+    Channel[CurrentChannel].active = bFALSE;
+    Sequence_Release(&Sequence[CurrentChannel], &Channel[CurrentChannel]);
+  }
+
   return valid;
 }
 
+/*! @brief Trigger input callback, called on every debounced edge from the trigger ISR or Trigger_Poll.
+ *
+ *  The rising edge arms a burst on every channel, which starts on the next PIT sample, so the
+ *  start lags the edge by up to one sample period.
+ *  @param arg Unused.
+ *  @return void.
+ */
+static void TriggerCallback(void* arg)
+{
+  BOOL level = Trigger_Level();
+
+  for (uint8_t channelNb = 0; channelNb < NB_AWG_CHANNELS; channelNb++)
+  {
+    Channel[channelNb].gate = level;
+    if (level && (Channel[channelNb].mode == BURST_MODE))
+      Channel[channelNb].trigger = bTRUE;
+  }
+}
+
 /*!
 ** @}
 */
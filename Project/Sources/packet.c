@@ -2,7 +2,8 @@
  *
  *  @brief Contains the packet encoding and decoding for the serial port.
  *
- *  Implementation of functions for the "Tower to PC Protocol" 5-byte packets.
+ *  Implementation of functions for the "Tower to PC Protocol" 5-byte packets, and the
+ *  variable-length extended frames that carry bulk data between them.
  *
  *  @author Mohammad Yasin Azimi
  *  @date 2016-11-09
@@ -11,14 +12,203 @@
  * @addtogroup Packet_module Packet module documentation
  * @{
  */
+#include "OS.h"
+#include "crc.h"
 #include "UART.h"
 #include "LEDs.h"
+#include "ring.h"
 #include "packet.h"
 #include "MK70F12.h"
+#include "PE_Types.h"
+
+#if (PACKET_FRAME_MAX + PACKET_FRAME_OVERHEAD) > UART_FRAME_MAX
+#error An extended frame must fit in a UART transmit frame
+#endif
+
+// Extended frames held by the parser, one being received and the rest queued
+#define PACKET_FRAME_SLOTS 3
+
+// Receive queue records, each a tag byte followed by a 5-byte packet or nothing for an extended frame
+#define PACKET_RECORD_PACKET 0
+#define PACKET_RECORD_FRAME 1
 
 TPacket Packet;
+TPacketFrame PacketFrame;
 uint8_t const PACKET_ACK_MASK = 0x80;
 
+static TRing RxQueue;			/*!< Validated packets and frames waiting for the packet thread, in arrival order */
+static OS_ECB *PacketReady;		/*!< Counts the records in RxQueue */
+static TPacketFrame FrameSlots[PACKET_FRAME_SLOTS];	/*!< Extended frames being received or waiting in RxQueue */
+static uint8_t SlotIn;			/*!< The slot the parser receives the next extended frame into */
+static uint8_t SlotOut;			/*!< The slot of the oldest queued extended frame */
+static uint8_t volatile NbSlots;	/*!< The number of extended frames queued */
+static BOOL InFrame;			/*!< TRUE while the bytes of an extended frame are arriving */
+static uint16_t FrameReceived;		/*!< The payload and CRC bytes of the current extended frame received */
+static uint16_t FrameCRC;		/*!< The running CRC of the current extended frame */
+static uint16_t FrameCheck;		/*!< The CRC received at the end of the current extended frame */
+static uint8_t Frame[PACKET_NB_BYTES];	/*!< The bytes being assembled into the next packet */
+static uint8_t FrameLength;		/*!< The number of bytes in Frame */
+static BOOL InSync;			/*!< TRUE while packets are arriving back to back */
+static uint32_t NbPackets;		/*!< The number of valid packets queued */
+static uint32_t NbChecksumErrors;	/*!< The number of times a packet failed its checksum while in sync */
+static uint32_t NbResyncs;		/*!< The number of times a valid packet was found again after losing sync */
+static uint32_t NbDropped;		/*!< The number of valid packets dropped because the queue was full */
+static uint32_t NbFrames;		/*!< The number of valid extended frames queued */
+static uint32_t NbCRCErrors;		/*!< The number of extended frames that failed their CRC */
+
+/*! @brief Adds a received byte to the extended frame being assembled.
+ *
+ *  @param data The received byte.
+ *  @return void.
+ */
+static void ParseFrameByte(const uint8_t data)
+{
+  TPacketFrame* const frame = &FrameSlots[SlotIn];
+
+  if (FrameReceived < frame->length)
+  {
+    frame->payload[FrameReceived++] = data;
+    FrameCRC = CRC_Update(FrameCRC, data);
+    return;
+  }
+
+  // The CRC follows the payload, most significant byte first
+  FrameCheck = (FrameCheck << 8) | data;
+  if (++FrameReceived < frame->length + 2)
+    return;
+  InFrame = bFALSE;
+
+  if (FrameCheck != FrameCRC)
+  {
+    NbCRCErrors++;
+    InSync = bFALSE;
+    return;
+  }
+
+  if (!InSync)
+    NbResyncs++;
+  InSync = bTRUE;
+
+  // A slot is always kept free to receive into
+  if ((NbSlots < PACKET_FRAME_SLOTS - 1) && Ring_Put(&RxQueue, PACKET_RECORD_FRAME))
+  {
+    SlotIn = (SlotIn + 1) % PACKET_FRAME_SLOTS;
+    NbSlots++;
+    NbFrames++;
+    (void)OS_SemaphoreSignal(PacketReady);
+  }
+  else
+    NbDropped++;
+}
+
+/*! @brief Starts an extended frame if the bytes being assembled are its header.
+ *
+ *  @return BOOL - TRUE if they are the header of an extended frame.
+ */
+static BOOL ParseFrameHeader(void)
+{
+  TPacketFrame* const frame = &FrameSlots[SlotIn];
+  uint16union_t length;
+
+  if ((Frame[0] != PACKET_FRAME_SYNC1) || (Frame[1] != PACKET_FRAME_SYNC2))
+    return bFALSE;
+
+  length.s.Lo = Frame[3];
+  length.s.Hi = Frame[4];
+  if ((length.l == 0) || (length.l > PACKET_FRAME_MAX))
+    return bFALSE;
+
+  frame->type = Frame[2];
+  frame->length = length.l;
+
+  // The CRC covers the type, length and payload
+  FrameCRC = CRC_SEED;
+  for (uint8_t byte = 2; byte < PACKET_FRAME_HEADER; byte++)
+    FrameCRC = CRC_Update(FrameCRC, Frame[byte]);
+  FrameCheck = 0;
+  FrameReceived = 0;
+
+  return bTRUE;
+}
+
+/*! @brief Adds a received byte to the packet being assembled.
+ *
+ *  A packet whose checksum fails is slid along one byte at a time until it lines up again.
+ *  @param data The received byte.
+ *  @return void.
+ */
+static void ParseByte(const uint8_t data)
+{
+  uint8_t checksum = 0;
+
+  if (InFrame)
+  {
+    ParseFrameByte(data);
+    return;
+  }
+
+  Frame[FrameLength++] = data;
+  if (FrameLength < PACKET_NB_BYTES)
+    return;
+
+  // No 5-byte packet command starts with the sync bytes, so a header is never mistaken for one.
+  // While the window is sliding to find the packets again, sync bytes may be packet parameters,
+  // so a frame is only started in sync; after a bad frame the PC sends a packet to resynchronise.
+  if (InSync && ParseFrameHeader())
+  {
+    InFrame = bTRUE;
+    FrameLength = 0;
+    return;
+  }
+
+  for (uint8_t byte = 0; byte < PACKET_NB_BYTES - 1; byte++)
+    checksum ^= Frame[byte];
+
+  if (checksum == Frame[PACKET_NB_BYTES - 1])
+  {
+    if (!InSync)
+      NbResyncs++;
+    InSync = bTRUE;
+
+    // The whole record goes into the queue, or none of it
+    if ((Ring_Space(&RxQueue) > PACKET_NB_BYTES) && Ring_Put(&RxQueue, PACKET_RECORD_PACKET)
+	&& Ring_PutBlock(&RxQueue, Frame, PACKET_NB_BYTES))
+    {
+      NbPackets++;
+      (void)OS_SemaphoreSignal(PacketReady);
+    }
+    else
+      NbDropped++;
+    FrameLength = 0;
+  }
+  else
+  {
+    if (InSync)
+      NbChecksumErrors++;
+    InSync = bFALSE;
+
+    // Drop the oldest byte and wait for the next one
+    for (uint8_t byte = 0; byte < PACKET_NB_BYTES - 1; byte++)
+      Frame[byte] = Frame[byte + 1];
+    FrameLength = PACKET_NB_BYTES - 1;
+  }
+}
+
+/*! @brief UART receive callback, parses the bytes as they arrive.
+ *
+ *  @param arg Unused.
+ *  @return void.
+ *  @note Called from the UART ISRs, which makes this the only consumer of the received bytes.
+ */
+static void Parse(void* arg)
+{
+  uint16_t nbBytes = UART_InCount();
+
+  for (uint16_t byte = 0; byte < nbBytes; byte++)
+    ParseByte(UART_InPeek(byte));
+  UART_InSkip(nbBytes);
+}
+
 /*! @brief Initializes the packets by calling the initialization routines of the supporting software modules.
  *
  *  @param baudRate The desired baud rate in bits/sec.
@@ -27,65 +217,156 @@ uint8_t const PACKET_ACK_MASK = 0x80;
  */
 BOOL Packet_Init(const uint32_t baudRate, const uint32_t moduleClk)
 {
-  PacketPutSemaphore = OS_SemaphoreCreate(1);
-  return UART_Init(baudRate, moduleClk);
+  Ring_Init(&RxQueue);
+  PacketReady = OS_SemaphoreCreate(0);
+  FrameLength = 0;
+  InFrame = bFALSE;
+  SlotIn = 0;
+  SlotOut = 0;
+  NbSlots = 0;
+  PacketFrame.length = 0;
+  InSync = bTRUE;
+  NbPackets = 0;
+  NbChecksumErrors = 0;
+  NbResyncs = 0;
+  NbDropped = 0;
+  NbFrames = 0;
+  NbCRCErrors = 0;
+
+  return CRC_Init() && UART_Init(baudRate, moduleClk, Parse, NULL);
 }
 
-/*! @brief Checks the packets
+/*! @brief Takes the oldest packet or extended frame from the receive queue, waiting for one to arrive.
  *
- *  @return void.
+ *  An extended frame is placed in PacketFrame, and a packet in Packet with PacketFrame.length set to 0.
+ *  @param timeout The number of clock ticks to wait for a valid packet or frame, 0 to wait forever.
+ *  @return BOOL - TRUE if a valid packet or frame was received.
  */
-BOOL Packet_Validate(void)
+BOOL Packet_Get(const uint32_t timeout)
 {
-  if (Packet_Checksum != (Packet_Command ^ Packet_Parameter1 ^ Packet_Parameter2 ^ Packet_Parameter3))
-  {
-    Packet_Command = Packet_Parameter1;
-    Packet_Parameter1 = Packet_Parameter2;
-    Packet_Parameter2 = Packet_Parameter3;
-    Packet_Parameter3 = Packet_Checksum;
+  TPacketFrame* frame;
+  uint8_t record;
 
+  if (OS_SemaphoreWait(PacketReady, timeout) == OS_TIMEOUT)
     return bFALSE;
+
+  (void)Ring_Get(&RxQueue, &record);
+  if (record == PACKET_RECORD_PACKET)
+  {
+    (void)Ring_GetBlock(&RxQueue, Packet.bytes, PACKET_NB_BYTES);
+    PacketFrame.length = 0;
+    return bTRUE;
   }
+
+  // The slot is only handed back to the parser once the frame has been copied out
+  frame = &FrameSlots[SlotOut];
+  PacketFrame.type = frame->type;
+  PacketFrame.length = frame->length;
+  for (uint16_t byte = 0; byte < frame->length; byte++)
+    PacketFrame.payload[byte] = frame->payload[byte];
+  SlotOut = (SlotOut + 1) % PACKET_FRAME_SLOTS;
+
+  OS_DisableInterrupts();
+  NbSlots--;
+  OS_EnableInterrupts();
+
   return bTRUE;
 }
 
-/*! @brief Attempts to get a packet from the received data.
+/*! @brief Builds a packet in a transmit class's queue.
  *
- *  @return BOOL - TRUE if a valid packet was received.
+ *  @param class The transmit class.
+ *  @return void.
  */
-BOOL Packet_Get(void)
+static void Put(const TUARTClass class, const uint8_t command, const uint8_t parameter1, const uint8_t parameter2, const uint8_t parameter3)
 {
-  BOOL valid;
+  // The packet is built where the DMA will send it from, and queued whole
+  uint8_t* bytes = UART_OutReserve(PACKET_NB_BYTES, class);
 
-  for(uint8_t byte = 0; byte < 4; byte++)
-    UART_InChar(&Packet.bytes[byte]);
+  // Packet commands
+  bytes[0] = command;
+  bytes[1] = parameter1;
+  bytes[2] = parameter2;
+  bytes[3] = parameter3;
+  bytes[4] = command ^ parameter1 ^ parameter2 ^ parameter3;
 
-  do
-  {
-    // Checks the packet
-    UART_InChar(&Packet_Checksum);
-    valid = Packet_Validate();
-  } while (!valid);
+  UART_OutCommit(bytes);
 }
 
 /*! @brief Builds a packet and places it in the transmit FIFO buffer.
  *
  *  @return void.
+ *  @note The packet is sent ahead of any queued telemetry.
  */
 void Packet_Put(const uint8_t command, const uint8_t parameter1, const uint8_t parameter2, const uint8_t parameter3)
 {
-  // Semaphore to wait for packet put
-  OS_SemaphoreWait(PacketPutSemaphore, 0);
+  Put(UART_CLASS_CONTROL, command, parameter1, parameter2, parameter3);
+}
 
-  // Packet commands
-  UART_OutChar(command);
-  UART_OutChar(parameter1);
-  UART_OutChar(parameter2);
-  UART_OutChar(parameter3);
-  UART_OutChar(command ^ parameter1 ^ parameter2 ^ parameter3);
-
-  // Semaphore to signal packet put semaphore
-  OS_SemaphoreSignal(PacketPutSemaphore);
+/*! @brief Builds a telemetry packet and places it in the transmit FIFO buffer.
+ *
+ *  @return void.
+ *  @note Telemetry waits behind control packets, and its oldest packets are dropped when its limit is set and reached.
+ */
+void Packet_PutTelemetry(const uint8_t command, const uint8_t parameter1, const uint8_t parameter2, const uint8_t parameter3)
+{
+  Put(UART_CLASS_TELEMETRY, command, parameter1, parameter2, parameter3);
+}
+
+/*! @brief Builds an extended frame and places it in the transmit FIFO buffer.
+ *
+ *  @param type The frame's type.
+ *  @param payload The payload bytes.
+ *  @param length The number of payload bytes, 1 to PACKET_FRAME_MAX.
+ *  @return BOOL - TRUE if the frame was queued.
+ */
+BOOL Packet_PutFrame(const uint8_t type, const uint8_t payload[], const uint16_t length)
+{
+  uint8_t* bytes;
+  uint16_t crc;
+
+  if ((length == 0) || (length > PACKET_FRAME_MAX))
+    return bFALSE;
+
+  bytes = UART_OutReserve(length + PACKET_FRAME_OVERHEAD, UART_CLASS_CONTROL);
+
+  bytes[0] = PACKET_FRAME_SYNC1;
+  bytes[1] = PACKET_FRAME_SYNC2;
+  bytes[2] = type;
+  bytes[3] = (uint8_t)length;
+  bytes[4] = (uint8_t)(length >> 8);
+  for (uint16_t byte = 0; byte < length; byte++)
+    bytes[PACKET_FRAME_HEADER + byte] = payload[byte];
+
+  crc = CRC_Block(&bytes[2], length + PACKET_FRAME_HEADER - 2);
+  bytes[PACKET_FRAME_HEADER + length] = (uint8_t)(crc >> 8);
+  bytes[PACKET_FRAME_HEADER + length + 1] = (uint8_t)crc;
+
+  UART_OutCommit(bytes);
+
+  return bTRUE;
+}
+
+/*! @brief Reports the receive counters.
+ *
+ *  Sends the number of packets received, checksum errors, resynchronisations, packets and frames dropped,
+ *  extended frames received and extended frame CRC errors.
+ *  @param data The data sent with the command, which must be 0.
+ *  @return BOOL - TRUE if the command was valid.
+ */
+BOOL Packet_Stats(const uint16union_t data)
+{
+  if (data.l != 0)
+    return bFALSE;
+
+  Packet_Put(PACKET_STATS_COMMAND, 0, (uint8_t)NbPackets, (uint8_t)(NbPackets >> 8));
+  Packet_Put(PACKET_STATS_COMMAND, 1, (uint8_t)NbChecksumErrors, (uint8_t)(NbChecksumErrors >> 8));
+  Packet_Put(PACKET_STATS_COMMAND, 2, (uint8_t)NbResyncs, (uint8_t)(NbResyncs >> 8));
+  Packet_Put(PACKET_STATS_COMMAND, 3, (uint8_t)NbDropped, (uint8_t)(NbDropped >> 8));
+  Packet_Put(PACKET_STATS_COMMAND, 4, (uint8_t)NbFrames, (uint8_t)(NbFrames >> 8));
+  Packet_Put(PACKET_STATS_COMMAND, 5, (uint8_t)NbCRCErrors, (uint8_t)(NbCRCErrors >> 8));
+
+  return bTRUE;
 }
 
 /*!
@@ -2,7 +2,8 @@
  *
  *  @brief Routines to implement packet encoding and decoding for the serial port.
  *
- *  This contains the functions for implementing the "Tower to PC Protocol" 5-byte packets.
+ *  This contains the functions for implementing the "Tower to PC Protocol" 5-byte packets, and the
+ *  variable-length extended frames that carry bulk data between them.
  *
  *  @author PMcL
  *  @date 2016-11-09
@@ -16,9 +17,18 @@
 
 // Packet structure
 #define PACKET_NB_BYTES 5
+// Packet command for the receive counters
+#define PACKET_STATS_COMMAND 0x63
 
-// Packet semaphores
-OS_ECB *PacketPutSemaphore;
+// Extended frame structure: the sync bytes, type, length (LSB first), payload and CRC-16 (MSB first)
+#define PACKET_FRAME_SYNC1 0xA5
+#define PACKET_FRAME_SYNC2 0x5A
+#define PACKET_FRAME_HEADER 5
+#define PACKET_FRAME_OVERHEAD (PACKET_FRAME_HEADER + 2)
+// Maximum number of payload bytes in an extended frame
+#define PACKET_FRAME_MAX 256
+// Extended frame type that is sent straight back, for the PC to check the link
+#define PACKET_FRAME_ECHO 0x01
 
 #pragma pack(push)
 #pragma pack(1)
@@ -54,6 +64,13 @@ typedef union
 
 #pragma pack(pop)
 
+typedef struct
+{
+  uint8_t type;				/*!< The frame's type. */
+  uint16_t length;			/*!< The number of payload bytes, 0 if a 5-byte packet was received instead. */
+  uint8_t payload[PACKET_FRAME_MAX];	/*!< The frame's payload. */
+} TPacketFrame;
+
 #define Packet_Command     Packet.packetStruct.command
 #define Packet_Parameter1  Packet.packetStruct.parameters.separate.parameter1
 #define Packet_Parameter2  Packet.packetStruct.parameters.separate.parameter2
@@ -63,6 +80,7 @@ typedef union
 #define Packet_Checksum    Packet.packetStruct.checksum
 
 extern TPacket Packet;
+extern TPacketFrame PacketFrame;
 
 // Acknowledgment bit mask
 extern const uint8_t PACKET_ACK_MASK;
@@ -75,11 +93,13 @@ extern const uint8_t PACKET_ACK_MASK;
  */
 BOOL Packet_Init(const uint32_t baudRate, const uint32_t moduleClk);
 
-/*! @brief Attempts to get a packet from the received data.
+/*! @brief Takes the oldest packet or extended frame from the receive queue, waiting for one to arrive.
  *
- *  @return BOOL - TRUE if a valid packet was received.
+ *  An extended frame is placed in PacketFrame, and a packet in Packet with PacketFrame.length set to 0.
+ *  @param timeout The number of clock ticks to wait for a valid packet or frame, 0 to wait forever.
+ *  @return BOOL - TRUE if a valid packet or frame was received.
  */
-BOOL Packet_Get(void);
+BOOL Packet_Get(const uint32_t timeout);
 
 /*! @brief Builds a packet and places it in the transmit FIFO buffer.
  *
@@ -87,10 +107,29 @@ BOOL Packet_Get(void);
  */
 void Packet_Put(const uint8_t command, const uint8_t parameter1, const uint8_t parameter2, const uint8_t parameter3);
 
-/*! @brief Checks the packets
+/*! @brief Builds a telemetry packet and places it in the transmit FIFO buffer.
  *
  *  @return void.
+ *  @note Telemetry waits behind control packets, and its oldest packets are dropped when its limit is set and reached.
+ */
+void Packet_PutTelemetry(const uint8_t command, const uint8_t parameter1, const uint8_t parameter2, const uint8_t parameter3);
+
+/*! @brief Builds an extended frame and places it in the transmit FIFO buffer.
+ *
+ *  @param type The frame's type.
+ *  @param payload The payload bytes.
+ *  @param length The number of payload bytes, 1 to PACKET_FRAME_MAX.
+ *  @return BOOL - TRUE if the frame was queued.
+ */
+BOOL Packet_PutFrame(const uint8_t type, const uint8_t payload[], const uint16_t length);
+
+/*! @brief Reports the receive counters.
+ *
+ *  Sends the number of packets received, checksum errors, resynchronisations, packets and frames dropped,
+ *  extended frames received and extended frame CRC errors.
+ *  @param data The data sent with the command, which must be 0.
+ *  @return BOOL - TRUE if the command was valid.
  */
-BOOL Packet_Validate(void);
+BOOL Packet_Stats(const uint16union_t data);
 
 #endif
@@ -0,0 +1,222 @@
+/*! @file
+ *
+ *  @brief Lock-free single-producer, single-consumer ring buffer.
+ *
+ *  Implementation of a byte-wide ring that one producer and one consumer can use at the same
+ *  time without a critical section or a mutex. Only the producer writes Head and only the
+ *  consumer writes Tail. Both count bytes ever moved and wrap naturally, so the ring is full
+ *  when they differ by RING_SIZE and empty when they are equal.
+ *
+ *  @author Mohammad Yasin Azimi
+ *  @date 2016-11-09
+ */
+/*!
+ * @addtogroup Ring_module Ring module documentation
+ * @{
+ */
+#include "ring.h"
+
+// Orders the buffer accesses against the publication of Head or Tail
+#ifdef __arm__
+#define RING_BARRIER() __asm volatile ("dmb" ::: "memory")
+#else
+#define RING_BARRIER() __sync_synchronize()
+#endif
+
+// Position in the buffer of a free-running index
+#define RING_INDEX(index) ((index) & (RING_SIZE - 1))
+
+/*! @brief Initialize the ring before first use.
+ *
+ *  @param ring A pointer to the ring that needs initializing.
+ *  @return void
+ */
+void Ring_Init(TRing* const ring)
+{
+  ring->Head = 0;
+  ring->Tail = 0;
+}
+
+/*! @brief Gets the number of bytes in the ring.
+ *
+ *  @param ring A pointer to the ring.
+ *  @return uint16_t - The number of bytes; exact for the consumer and a lower bound for the producer.
+ */
+uint16_t Ring_Count(const TRing* const ring)
+{
+  return (uint16_t)(ring->Head - ring->Tail);
+}
+
+/*! @brief Gets the free space in the ring.
+ *
+ *  @param ring A pointer to the ring.
+ *  @return uint16_t - The free space; exact for the producer and a lower bound for the consumer.
+ */
+uint16_t Ring_Space(const TRing* const ring)
+{
+  return RING_SIZE - (uint16_t)(ring->Head - ring->Tail);
+}
+
+/*! @brief Put one byte into the ring.
+ *
+ *  @param ring A pointer to the ring.
+ *  @param data The byte to store.
+ *  @return BOOL - TRUE if the byte was stored, FALSE if the ring was full.
+ *  @note Only the producer may call this.
+ */
+BOOL Ring_Put(TRing* const ring, const uint8_t data)
+{
+  uint16_t head = ring->Head;
+
+  if ((uint16_t)(head - ring->Tail) == RING_SIZE)
+    return bFALSE;
+
+  // The byte must be in place before the consumer can see it
+  ring->Buffer[RING_INDEX(head)] = data;
+  RING_BARRIER();
+  ring->Head = head + 1;
+
+  return bTRUE;
+}
+
+/*! @brief Get one byte from the ring.
+ *
+ *  @param ring A pointer to the ring.
+ *  @param dataPtr A pointer to a memory location to place the retrieved byte.
+ *  @return BOOL - TRUE if a byte was retrieved, FALSE if the ring was empty.
+ *  @note Only the consumer may call this.
+ */
+BOOL Ring_Get(TRing* const ring, uint8_t* const dataPtr)
+{
+  uint16_t tail = ring->Tail;
+
+  if (ring->Head == tail)
+    return bFALSE;
+
+  // The byte is read only after Head shows it, and released only after it has been read
+  RING_BARRIER();
+  *dataPtr = ring->Buffer[RING_INDEX(tail)];
+  RING_BARRIER();
+  ring->Tail = tail + 1;
+
+  return bTRUE;
+}
+
+/*! @brief Put a block of bytes into the ring, all or nothing.
+ *
+ *  @param ring A pointer to the ring.
+ *  @param data The bytes to store.
+ *  @param length The number of bytes to store.
+ *  @return BOOL - TRUE if the block was stored, FALSE if there was not room for all of it.
+ *  @note Only the producer may call this.
+ */
+BOOL Ring_PutBlock(TRing* const ring, const uint8_t data[], const uint16_t length)
+{
+  uint16_t head = ring->Head;
+
+  if (RING_SIZE - (uint16_t)(head - ring->Tail) < length)
+    return bFALSE;
+
+  for (uint16_t byte = 0; byte < length; byte++)
+    ring->Buffer[RING_INDEX(head + byte)] = data[byte];
+
+  // The whole block becomes visible to the consumer at once
+  RING_BARRIER();
+  ring->Head = head + length;
+
+  return bTRUE;
+}
+
+/*! @brief Get up to a block of bytes from the ring.
+ *
+ *  @param ring A pointer to the ring.
+ *  @param data A pointer to memory to place the retrieved bytes.
+ *  @param length The largest number of bytes to retrieve.
+ *  @return uint16_t - The number of bytes retrieved.
+ *  @note Only the consumer may call this.
+ */
+uint16_t Ring_GetBlock(TRing* const ring, uint8_t data[], const uint16_t length)
+{
+  uint16_t tail = ring->Tail;
+  uint16_t count = (uint16_t)(ring->Head - tail);
+
+  if (count > length)
+    count = length;
+
+  if (count == 0)
+    return 0;
+
+  RING_BARRIER();
+  for (uint16_t byte = 0; byte < count; byte++)
+    data[byte] = ring->Buffer[RING_INDEX(tail + byte)];
+  RING_BARRIER();
+  ring->Tail = tail + count;
+
+  return count;
+}
+
+
+/*! @brief Gets a byte from the ring without taking it.
+ *
+ *  @param ring A pointer to the ring.
+ *  @param offset The position of the byte after the oldest one, which must be less than Ring_Count.
+ *  @return uint8_t - The byte.
+ *  @note Only the consumer may call this.
+ */
+uint8_t Ring_Peek(const TRing* const ring, const uint16_t offset)
+{
+  RING_BARRIER();
+  return ring->Buffer[RING_INDEX(ring->Tail + offset)];
+}
+
+/*! @brief Gets the oldest bytes in the ring that lie in one piece of the buffer.
+ *
+ *  @param ring A pointer to the ring.
+ *  @param dataPtr A pointer to where the address of the oldest byte is placed.
+ *  @return uint16_t - The number of bytes from there to the newest byte or the end of the buffer.
+ *  @note Only the consumer may call this; the bytes stay in the ring until Ring_Skip.
+ */
+uint16_t Ring_Contiguous(const TRing* const ring, const uint8_t** const dataPtr)
+{
+  uint16_t tail = ring->Tail;
+  uint16_t count = (uint16_t)(ring->Head - tail);
+
+  if (count > RING_SIZE - RING_INDEX(tail))
+    count = RING_SIZE - RING_INDEX(tail);
+
+  // The caller reads the bytes only after Head shows them
+  RING_BARRIER();
+  *dataPtr = &ring->Buffer[RING_INDEX(tail)];
+  return count;
+}
+
+/*! @brief Takes bytes out of the ring without copying them.
+ *
+ *  @param ring A pointer to the ring.
+ *  @param length The number of bytes to take, which must be no more than Ring_Count.
+ *  @return void
+ *  @note Only the consumer may call this.
+ */
+void Ring_Skip(TRing* const ring, const uint16_t length)
+{
+  // The bytes are released only after they have been read
+  RING_BARRIER();
+  ring->Tail = ring->Tail + length;
+}
+
+/*! @brief Makes bytes already written into the buffer visible to the consumer.
+ *
+ *  @param ring A pointer to the ring.
+ *  @param length The number of bytes written after the newest byte, which must fit in Ring_Space.
+ *  @return void
+ *  @note Only the producer may call this, for bytes it placed in Buffer itself, e.g. by DMA.
+ */
+void Ring_Advance(TRing* const ring, const uint16_t length)
+{
+  RING_BARRIER();
+  ring->Head = ring->Head + length;
+}
+
+/*!
+ * @}
+ */
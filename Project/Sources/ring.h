@@ -0,0 +1,129 @@
+/*! @file
+ *
+ *  @brief Routines to implement a lock-free single-producer, single-consumer ring buffer.
+ *
+ *  This contains the structure and "methods" for a byte-wide ring that one producer and one
+ *  consumer can use at the same time without a critical section or a mutex.
+ *
+ *  @author Mohammad Yasin Azimi
+ *  @date 2016-11-09
+ */
+#ifndef RING_H
+#define RING_H
+
+// new types
+#include "types.h"
+
+// Number of bytes in a ring, a power of two
+#define RING_SIZE 256
+
+#if (RING_SIZE & (RING_SIZE - 1)) != 0
+#error RING_SIZE must be a power of two
+#endif
+
+/*!
+ * @struct TRing
+ */
+typedef struct
+{
+  uint16_t volatile Head;	/*!< The number of bytes ever put, written only by the producer */
+  uint16_t volatile Tail;	/*!< The number of bytes ever taken, written only by the consumer */
+  uint8_t Buffer[RING_SIZE];	/*!< The actual array of bytes to store the data */
+} TRing;
+
+/*! @brief Initialize the ring before first use.
+ *
+ *  @param ring A pointer to the ring that needs initializing.
+ *  @return void
+ */
+void Ring_Init(TRing* const ring);
+
+/*! @brief Gets the number of bytes in the ring.
+ *
+ *  @param ring A pointer to the ring.
+ *  @return uint16_t - The number of bytes; exact for the consumer and a lower bound for the producer.
+ */
+uint16_t Ring_Count(const TRing* const ring);
+
+/*! @brief Gets the free space in the ring.
+ *
+ *  @param ring A pointer to the ring.
+ *  @return uint16_t - The free space; exact for the producer and a lower bound for the consumer.
+ */
+uint16_t Ring_Space(const TRing* const ring);
+
+/*! @brief Put one byte into the ring.
+ *
+ *  @param ring A pointer to the ring.
+ *  @param data The byte to store.
+ *  @return BOOL - TRUE if the byte was stored, FALSE if the ring was full.
+ *  @note Only the producer may call this.
+ */
+BOOL Ring_Put(TRing* const ring, const uint8_t data);
+
+/*! @brief Get one byte from the ring.
+ *
+ *  @param ring A pointer to the ring.
+ *  @param dataPtr A pointer to a memory location to place the retrieved byte.
+ *  @return BOOL - TRUE if a byte was retrieved, FALSE if the ring was empty.
+ *  @note Only the consumer may call this.
+ */
+BOOL Ring_Get(TRing* const ring, uint8_t* const dataPtr);
+
+/*! @brief Put a block of bytes into the ring, all or nothing.
+ *
+ *  @param ring A pointer to the ring.
+ *  @param data The bytes to store.
+ *  @param length The number of bytes to store.
+ *  @return BOOL - TRUE if the block was stored, FALSE if there was not room for all of it.
+ *  @note Only the producer may call this.
+ */
+BOOL Ring_PutBlock(TRing* const ring, const uint8_t data[], const uint16_t length);
+
+/*! @brief Get up to a block of bytes from the ring.
+ *
+ *  @param ring A pointer to the ring.
+ *  @param data A pointer to memory to place the retrieved bytes.
+ *  @param length The largest number of bytes to retrieve.
+ *  @return uint16_t - The number of bytes retrieved.
+ *  @note Only the consumer may call this.
+ */
+uint16_t Ring_GetBlock(TRing* const ring, uint8_t data[], const uint16_t length);
+
+/*! @brief Gets a byte from the ring without taking it.
+ *
+ *  @param ring A pointer to the ring.
+ *  @param offset The position of the byte after the oldest one, which must be less than Ring_Count.
+ *  @return uint8_t - The byte.
+ *  @note Only the consumer may call this.
+ */
+uint8_t Ring_Peek(const TRing* const ring, const uint16_t offset);
+
+/*! @brief Gets the oldest bytes in the ring that lie in one piece of the buffer.
+ *
+ *  @param ring A pointer to the ring.
+ *  @param dataPtr A pointer to where the address of the oldest byte is placed.
+ *  @return uint16_t - The number of bytes from there to the newest byte or the end of the buffer.
+ *  @note Only the consumer may call this; the bytes stay in the ring until Ring_Skip.
+ */
+uint16_t Ring_Contiguous(const TRing* const ring, const uint8_t** const dataPtr);
+
+/*! @brief Takes bytes out of the ring without copying them.
+ *
+ *  @param ring A pointer to the ring.
+ *  @param length The number of bytes to take, which must be no more than Ring_Count.
+ *  @return void
+ *  @note Only the consumer may call this.
+ */
+void Ring_Skip(TRing* const ring, const uint16_t length);
+
+/*! @brief Makes bytes already written into the buffer visible to the consumer.
+ *
+ *  @param ring A pointer to the ring.
+ *  @param length The number of bytes written after the newest byte, which must fit in Ring_Space.
+ *  @return void
+ *  @note Only the producer may call this, for bytes it placed in Buffer itself, e.g. by DMA.
+ */
+void Ring_Advance(TRing* const ring, const uint16_t length);
+
+#endif
@@ -0,0 +1,247 @@
+/*! @file
+ *
+ *  @brief Routines for stepping a channel through a table of waveform segments.
+ *
+ *  Implementation of functions for uploading and playing back a waveform sequence.
+ *
+ *  @author Mohammad Yasin Azimi
+ *  @date 2016-11-09
+ */
+/*!
+ * @addtogroup Sequence_module Sequence module documentation
+ * @{
+ */
+#include "AWG.h"
+#include "types.h"
+#include "packet.h"
+#include "sequence.h"
+
+/*! @brief Initialises a sequence to an empty table.
+ *
+ *  @param aSequence A pointer to the sequence to initialise.
+ *  @return void.
+ */
+void Sequence_Init(TSequence* const aSequence)
+{
+  aSequence->nbSegments  = 0;
+  aSequence->segmentNb   = 0;
+  aSequence->playNb      = 0;
+  aSequence->samplesLeft = 0;
+  aSequence->frequencyLo = 0;
+  aSequence->loop        = bFALSE;
+  aSequence->running     = bFALSE;
+  aSequence->played      = bFALSE;
+
+  for (uint8_t segmentNb = 0; segmentNb < SEQUENCE_MAX_SEGMENTS; segmentNb++)
+  {
+    aSequence->segments[segmentNb].output.waveformType = SINE_WAVE;
+    aSequence->segments[segmentNb].output.frequency.l  = 0;
+    aSequence->segments[segmentNb].output.amplitude.l  = 0;
+    aSequence->segments[segmentNb].output.offset.l     = 0;
+    aSequence->segments[segmentNb].output.phaseIncrement = 0;
+    aSequence->segments[segmentNb].output.duty.l       = 32768;
+    aSequence->segments[segmentNb].output.dutyLimit    = 0x80000000;
+    aSequence->segments[segmentNb].duration.l          = 0;
+  }
+}
+
+/*! @brief Edits, starts or stops a sequence.
+ *
+ *  @param aSequence A pointer to the sequence being controlled.
+ *  @param control The sequence control command.
+ *  @param data The data sent with the command.
+ *  @return BOOL - TRUE if the command was valid.
+ *  @note The segment table can only be edited while the sequence is stopped.
+ */
+BOOL Sequence_Control(TSequence* const aSequence, const TSequenceControl control, const uint16union_t data)
+{
+  BOOL valid;
+  TSegment* segment;
+  segment = &aSequence->segments[aSequence->segmentNb];
+
+  // The table is played by the PIT thread, so it is only changed while stopped
+  if (aSequence->running && (control != SEQUENCE_STATUS_CHECK) && (control != SEQUENCE_STOP))
+    return bFALSE;
+
+  switch (control)
+  {
+    case SEQUENCE_STATUS_CHECK:
+      valid = (data.l == 0);
+      if (!valid)
+        break;
+      Packet_Put(SEQUENCE_COMMAND, SEQUENCE_STATUS_CHECK, aSequence->nbSegments, aSequence->running);
+      Packet_Put(SEQUENCE_COMMAND, SEQUENCE_SEGMENT_SELECT, aSequence->segmentNb, 0);
+      Packet_Put(SEQUENCE_COMMAND, SEQUENCE_WAVEFORM_CHANGE, segment->output.waveformType, 0);
+      Packet_Put(SEQUENCE_COMMAND, SEQUENCE_FREQUENCY_LO, (uint8_t)segment->output.frequency.s.Lo, (uint8_t)(segment->output.frequency.s.Lo >> 8));
+      Packet_Put(SEQUENCE_COMMAND, SEQUENCE_FREQUENCY_HI, (uint8_t)segment->output.frequency.s.Hi, (uint8_t)(segment->output.frequency.s.Hi >> 8));
+      Packet_Put(SEQUENCE_COMMAND, SEQUENCE_AMPLITUDE_CHANGE, segment->output.amplitude.s.Lo, segment->output.amplitude.s.Hi);
+      Packet_Put(SEQUENCE_COMMAND, SEQUENCE_OFFSET_CHANGE, segment->output.offset.s.Lo, segment->output.offset.s.Hi);
+      Packet_Put(SEQUENCE_COMMAND, SEQUENCE_DUTY_CHANGE, segment->output.duty.s.Lo, segment->output.duty.s.Hi);
+      Packet_Put(SEQUENCE_COMMAND, SEQUENCE_DURATION_LO, (uint8_t)segment->duration.s.Lo, (uint8_t)(segment->duration.s.Lo >> 8));
+      Packet_Put(SEQUENCE_COMMAND, SEQUENCE_DURATION_HI, (uint8_t)segment->duration.s.Hi, (uint8_t)(segment->duration.s.Hi >> 8));
+      break;
+
+    case SEQUENCE_SEGMENT_SELECT:
+      valid = ((data.s.Hi == 0) && (data.s.Lo < SEQUENCE_MAX_SEGMENTS));
+      if (!valid)
+        break;
+      aSequence->segmentNb = data.s.Lo;
+      break;
+
+    case SEQUENCE_WAVEFORM_CHANGE:
+      valid = ((data.s.Lo <= PULSE_WAVE) && (data.s.Hi == 0));
+      if (!valid)
+        break;
+      segment->output.waveformType = data.s.Lo;
+      break;
+
+    case SEQUENCE_FREQUENCY_CHANGE:
+      // Legacy 8.8 fixed point frequency
+      valid = AWG_FrequencyValid((uint32_t)data.l << 8);
+      if (!valid)
+        break;
+      segment->output.frequency.l = (uint32_t)data.l << 8;
+      // Precomputed so the segment transition is only a copy
+      segment->output.phaseIncrement = AWG_PhaseIncrement(segment->output.frequency.l);
+      break;
+
+    case SEQUENCE_FREQUENCY_LO:
+      // Held until the high half arrives, so the 32-bit frequency is checked and applied whole
+      valid = bTRUE;
+      aSequence->frequencyLo = data.l;
+      break;
+
+    case SEQUENCE_FREQUENCY_HI:
+      valid = AWG_FrequencyValid(((uint32_t)data.l << 16) | aSequence->frequencyLo);
+      if (!valid)
+        break;
+      segment->output.frequency.s.Lo = aSequence->frequencyLo;
+      segment->output.frequency.s.Hi = data.l;
+      segment->output.phaseIncrement = AWG_PhaseIncrement(segment->output.frequency.l);
+      break;
+
+    case SEQUENCE_AMPLITUDE_CHANGE:
+      valid = (data.l <= 32767);
+      if (!valid)
+        break;
+      segment->output.amplitude = data;
+      break;
+
+    case SEQUENCE_OFFSET_CHANGE:
+      valid = ((int16_t)data.l >= -32767);
+      if (!valid)
+        break;
+      segment->output.offset.l = (int16_t)data.l;
+      break;
+
+    case SEQUENCE_DUTY_CHANGE:
+      // 0 and 0xFFFF would hold the output at one level
+      valid = ((data.l > 0) && (data.l < 0xFFFF));
+      if (!valid)
+        break;
+      segment->output.duty = data;
+      segment->output.dutyLimit = (uint32_t)data.l << 16;
+      break;
+
+    case SEQUENCE_DURATION_LO:
+      valid = bTRUE;
+      segment->duration.s.Lo = data.l;
+      break;
+
+    case SEQUENCE_DURATION_HI:
+      valid = bTRUE;
+      segment->duration.s.Hi = data.l;
+      break;
+
+    case SEQUENCE_LENGTH_CHANGE:
+      valid = ((data.s.Hi == 0) && (data.s.Lo <= SEQUENCE_MAX_SEGMENTS));
+      if (!valid)
+        break;
+      aSequence->nbSegments = data.s.Lo;
+      break;
+
+    case SEQUENCE_START:
+      // Data selects a single pass (0) or a continuous loop (1)
+      valid = ((data.l <= 1) && (aSequence->nbSegments > 0));
+      for (uint8_t segmentNb = 0; valid && (segmentNb < aSequence->nbSegments); segmentNb++)
+        // Every segment must last at least one sample
+        valid = (aSequence->segments[segmentNb].duration.l > 0);
+      if (!valid)
+        break;
+      aSequence->loop        = (BOOL)data.l;
+      aSequence->playNb      = 0;
+      aSequence->samplesLeft = 0;
+      aSequence->played      = bTRUE;
+      aSequence->running     = bTRUE;
+      break;
+
+    case SEQUENCE_STOP:
+      valid = ((data.l == 0) && (aSequence->running));
+      if (!valid)
+        break;
+      aSequence->running = bFALSE;
+      break;
+
+    default:
+      valid = bFALSE;
+  }
+
+  return valid;
+}
+
+/*! @brief Advances a running sequence by one sample.
+ *
+ *  The next segment's settings are applied to the channel on the sample boundary where
+ *  the current segment's duration expires. The channel plays them from the sequence's own
+ *  buffer, leaving its staged settings for Sequence_Release.
+ *  @param aSequence A pointer to the running sequence.
+ *  @param aChannel A pointer to the channel playing the sequence.
+ *  @return BOOL - TRUE if the sequence is still running after this sample.
+ */
+BOOL Sequence_Step(TSequence* const aSequence, TChannel* const aChannel)
+{
+  if (aSequence->samplesLeft == 0)
+  {
+    // Wrap around or finish once the last segment has been played
+    if (aSequence->playNb >= aSequence->nbSegments)
+    {
+      if (!aSequence->loop)
+      {
+        aSequence->running = bFALSE;
+        return bFALSE;
+      }
+      aSequence->playNb = 0;
+    }
+
+    // The segment settings are already in channel form, so the transition is a single copy
+    aSequence->output = aSequence->segments[aSequence->playNb].output;
+    AWG_Apply(aChannel, &aSequence->output);
+    aSequence->samplesLeft = aSequence->segments[aSequence->playNb].duration.l;
+    aSequence->playNb++;
+  }
+
+  aSequence->samplesLeft--;
+
+  return bTRUE;
+}
+
+/*! @brief Hands a channel back to its staged settings once its sequence has ended or been stopped.
+ *
+ *  The channel goes on playing the last segment until then, so it is published to again here.
+ *  @param aSequence A pointer to the sequence.
+ *  @param aChannel A pointer to the channel that played the sequence.
+ *  @return void.
+ *  @note Must be called from the thread that publishes to the channel. Does nothing while the sequence runs.
+ */
+void Sequence_Release(TSequence* const aSequence, TChannel* const aChannel)
+{
+  if (aSequence->running || !aSequence->played)
+    return;
+
+  aSequence->played = bFALSE;
+  AWG_Publish(aChannel);
+}
+
+/*!
+ * @}
+ */
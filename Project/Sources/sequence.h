@@ -0,0 +1,98 @@
+/*! @file
+ *
+ *  @brief Routines for stepping a channel through a table of waveform segments.
+ *
+ *  This contains the functions for uploading and playing back a waveform sequence.
+ *
+ *  @author Mohammad Yasin Azimi
+ *  @date 2016-11-09
+ */
+#ifndef SEQUENCE_H
+#define SEQUENCE_H
+
+// new types
+#include "types.h"
+#include "AWG.h"
+
+// Packet command for sequence control
+#define SEQUENCE_COMMAND 0x61
+// Maximum number of segments in a sequence
+#define SEQUENCE_MAX_SEGMENTS 16
+
+typedef enum
+{
+  SEQUENCE_STATUS_CHECK		= 0,
+  SEQUENCE_SEGMENT_SELECT	= 1,
+  SEQUENCE_WAVEFORM_CHANGE	= 2,
+  SEQUENCE_FREQUENCY_CHANGE	= 3,
+  SEQUENCE_AMPLITUDE_CHANGE	= 4,
+  SEQUENCE_OFFSET_CHANGE	= 5,
+  SEQUENCE_DURATION_LO		= 6,
+  SEQUENCE_DURATION_HI		= 7,
+  SEQUENCE_LENGTH_CHANGE	= 8,
+  SEQUENCE_START		= 9,
+  SEQUENCE_STOP			= 10,
+  SEQUENCE_FREQUENCY_LO		= 11,
+  SEQUENCE_FREQUENCY_HI		= 12,
+  SEQUENCE_DUTY_CHANGE		= 13
+}TSequenceControl;
+
+typedef struct
+{
+  TAWGSettings		output;		/*!< The waveform settings applied for this segment */
+  uint32union_t		duration;	/*!< The number of samples the segment is played for */
+}TSegment;
+
+typedef struct
+{
+  TSegment		segments[SEQUENCE_MAX_SEGMENTS];	/*!< The uploaded segment table */
+  uint8_t		nbSegments;				/*!< The number of segments in the table */
+  uint8_t		segmentNb;				/*!< The segment currently being edited */
+  uint8_t		playNb;					/*!< The next segment to be played */
+  uint32_t		samplesLeft;				/*!< The samples left before the next segment */
+  uint16_t		frequencyLo;				/*!< The low half of a 32-bit frequency waiting for its high half */
+  BOOL			loop;					/*!< TRUE if the sequence restarts after the last segment */
+  BOOL volatile		running;				/*!< TRUE if the sequence is being played */
+  BOOL			played;					/*!< TRUE until the channel is handed back after the sequence */
+  TAWGSettings		output;					/*!< The settings of the segment being played, which the channel plays from */
+}TSequence;
+
+/*! @brief Initialises a sequence to an empty table.
+ *
+ *  @param aSequence A pointer to the sequence to initialise.
+ *  @return void.
+ */
+void Sequence_Init(TSequence* const aSequence);
+
+/*! @brief Edits, starts or stops a sequence.
+ *
+ *  @param aSequence A pointer to the sequence being controlled.
+ *  @param control The sequence control command.
+ *  @param data The data sent with the command.
+ *  @return BOOL - TRUE if the command was valid.
+ *  @note The segment table can only be edited while the sequence is stopped.
+ */
+BOOL Sequence_Control(TSequence* const aSequence, const TSequenceControl control, const uint16union_t data);
+
+/*! @brief Advances a running sequence by one sample.
+ *
+ *  The next segment's settings are applied to the channel on the sample boundary where
+ *  the current segment's duration expires. The channel plays them from the sequence's own
+ *  buffer, leaving its staged settings for Sequence_Release.
+ *  @param aSequence A pointer to the running sequence.
+ *  @param aChannel A pointer to the channel playing the sequence.
+ *  @return BOOL - TRUE if the sequence is still running after this sample.
+ */
+BOOL Sequence_Step(TSequence* const aSequence, TChannel* const aChannel);
+
+/*! @brief Hands a channel back to its staged settings once its sequence has ended or been stopped.
+ *
+ *  The channel goes on playing the last segment until then, so it is published to again here.
+ *  @param aSequence A pointer to the sequence.
+ *  @param aChannel A pointer to the channel that played the sequence.
+ *  @return void.
+ *  @note Must be called from the thread that publishes to the channel. Does nothing while the sequence runs.
+ */
+void Sequence_Release(TSequence* const aSequence, TChannel* const aChannel);
+
+#endif
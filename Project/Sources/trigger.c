@@ -0,0 +1,142 @@
+/*! @file
+ *
+ *  @brief Routines for the external trigger input on the TWR-K70F120M.
+ *
+ *  Implementation of functions for detecting edges on the trigger / gate input (PTD0, SW1).
+ *
+ *  @author Mohammad Yasin Azimi
+ *  @date 2016-11-09
+ */
+/*!
+ * @addtogroup Trigger_module Trigger module documentation
+ * @{
+ */
+#include "OS.h"
+#include "types.h"
+#include "trigger.h"
+#include "MK70F12.h"
+
+// Trigger input pin on PORTD
+#define TRIGGER_PIN 0
+// Interrupt on either edge
+#define TRIGGER_IRQC_EITHER_EDGE 0xB
+// Clock ticks after an edge during which SW1 is taken to be bouncing
+#define TRIGGER_DEBOUNCE_TICKS 20
+
+static void (*UserFunction)(void*);
+static void* UserArguments;
+static BOOL volatile Level;		/*!< The debounced level of the input */
+static BOOL volatile Settling;		/*!< TRUE while edges are ignored after an accepted edge */
+static uint32_t LastEdge;		/*!< The OS clock when the last edge was accepted */
+
+/*! @brief Reads the level of the trigger pin.
+ *
+ *  @return BOOL - TRUE if the pin is high.
+ */
+static BOOL PinLevel(void)
+{
+  return ((GPIOD_PDIR & (1 << TRIGGER_PIN)) != 0);
+}
+
+/*! @brief Sets up the trigger input before first use.
+ *
+ *  Configures PTD0 as a pulled-up GPIO input that interrupts on both edges.
+ *  @param userFunction is a pointer to a user callback function called on every debounced edge.
+ *  @param userArguments is a pointer to the user arguments to use with the user callback function.
+ *  @return BOOL - TRUE if the trigger input was successfully initialized.
+ */
+BOOL Trigger_Init(void (*userFunction)(void*), void* userArguments)
+{
+  UserFunction = userFunction;
+  UserArguments = userArguments;
+
+  // Enable clock gate port D
+  SIM_SCGC5 |= SIM_SCGC5_PORTD_MASK;
+
+  // PTD0 is a GPIO with the pull-up and passive filter enabled, interrupting on either edge
+  PORTD_PCR0 = PORT_PCR_MUX(1) | PORT_PCR_PE_MASK | PORT_PCR_PS_MASK | PORT_PCR_PFE_MASK | PORT_PCR_IRQC(TRIGGER_IRQC_EITHER_EDGE);
+  // Sets the pin as an input
+  GPIOD_PDDR &= ~(1 << TRIGGER_PIN);
+  // Clear any edge detected before setup
+  PORTD_ISFR = (1 << TRIGGER_PIN);
+
+  // The input idles high, and users read its level before the first edge
+  Level = PinLevel();
+  Settling = bFALSE;
+
+  // Clear any pending interrupts on PORTD
+  NVICICPR2 = (1<<(90 % 32));
+  // Enable interrupts from PORTD
+  NVICISER2 = (1<<(90 % 32));
+
+  return bTRUE;
+}
+
+/*! @brief Reads the level of the trigger input.
+ *
+ *  @return BOOL - TRUE if the debounced input is high.
+ */
+BOOL Trigger_Level(void)
+{
+  return Level;
+}
+
+/*! @brief Ends the debounce interval once it has passed.
+ *
+ *  The pin is read again when the interval ends, and a level that differs from the one last
+ *  reported is passed to the user callback as an edge.
+ *  @return void.
+ *  @note Must be called periodically from a thread.
+ */
+void Trigger_Poll(void)
+{
+  BOOL changed = bFALSE;
+
+  OS_DisableInterrupts();
+  if (Settling && (OS_TimeGet() - LastEdge >= TRIGGER_DEBOUNCE_TICKS))
+  {
+    Settling = bFALSE;
+    changed = (PinLevel() != Level);
+    if (changed)
+      Level = !Level;
+  }
+  OS_EnableInterrupts();
+
+  if (changed && UserFunction)
+    (*UserFunction)(UserArguments);
+}
+
+/*! @brief Interrupt service routine for the trigger input.
+ *
+ *  An edge has been detected on the trigger input.
+ *  The user callback function will be called, unless the input is still settling from the last edge.
+ *  @note Assumes the trigger input has been initialized.
+ */
+void __attribute__ ((interrupt)) Trigger_ISR(void)
+{
+  OS_ISREnter();
+
+  if (PORTD_ISFR & (1 << TRIGGER_PIN))
+  {
+    // Write 1 to clear the interrupt status flag
+    PORTD_ISFR = (1 << TRIGGER_PIN);
+
+    // The first edge is passed on at once and the bounces after it are ignored.
+    // The passive filter only removes glitches of a few hundred nanoseconds.
+    if (!Settling)
+    {
+      Level = !Level;
+      Settling = bTRUE;
+      LastEdge = OS_TimeGet();
+
+      if (UserFunction)
+        (*UserFunction)(UserArguments);
+    }
+  }
+
+  OS_ISRExit();
+}
+
+/*!
+ * @}
+ */
@@ -0,0 +1,48 @@
+/*! @file
+ *
+ *  @brief Routines for the external trigger input on the TWR-K70F120M.
+ *
+ *  This contains the functions for detecting edges on the trigger / gate input (PTD0, SW1).
+ *
+ *  @author Mohammad Yasin Azimi
+ *  @date 2016-11-09
+ */
+#ifndef TRIGGER_H
+#define TRIGGER_H
+
+// new types
+#include "types.h"
+
+/*! @brief Sets up the trigger input before first use.
+ *
+ *  Configures PTD0 as a pulled-up GPIO input that interrupts on both edges.
+ *  @param userFunction is a pointer to a user callback function called on every debounced edge.
+ *  @param userArguments is a pointer to the user arguments to use with the user callback function.
+ *  @return BOOL - TRUE if the trigger input was successfully initialized.
+ */
+BOOL Trigger_Init(void (*userFunction)(void*), void* userArguments);
+
+/*! @brief Reads the level of the trigger input.
+ *
+ *  @return BOOL - TRUE if the debounced input is high.
+ */
+BOOL Trigger_Level(void);
+
+/*! @brief Ends the debounce interval once it has passed.
+ *
+ *  The pin is read again when the interval ends, and a level that differs from the one last
+ *  reported is passed to the user callback as an edge.
+ *  @return void.
+ *  @note Must be called periodically from a thread.
+ */
+void Trigger_Poll(void);
+
+/*! @brief Interrupt service routine for the trigger input.
+ *
+ *  An edge has been detected on the trigger input.
+ *  The user callback function will be called, unless the input is still settling from the last edge.
+ *  @note Assumes the trigger input has been initialized.
+ */
+void __attribute__ ((interrupt)) Trigger_ISR(void);
+
+#endif
@@ -15,38 +15,24 @@
 #include "waveform.h"
 
 #define FQ12Notation 12
+#define PHASE_BITS 32
 
 // This is half the period
-static uint32_t squareLimit;
-static uint32_t sawtoothLimit;
-
-/*! @brief Sets up the waveforms for the square waveform.
- *
- *  @param sampleFrequency The samples taken at the particular frequency.
- *  @return void.
- */
-void Square_Init(const uint16_t sampleFrequency)
-{
-  squareLimit = (sampleFrequency << FQ12Notation) / 2;
-}
+static const uint32_t squareLimit = (uint32_t)1 << (PHASE_BITS - 1);
 
 /*! @brief Calculates the digital output of the square waveform.
  *
- *  @param frequency The frequency in Q notation with 12 decimal accuracy.
- *  @param sampleNb The module clock rate in Hz.
+ *  @param phase The position in the period, where 2^32 is a full period.
+ *  @return int32_t - The output in Q notation with 12 decimal accuracy.
  */
-int32_t Waveform_Square(const uint16_t frequency, const uint16_t sampleNb)
+int32_t Waveform_Square(const uint32_t phase)
 {
   int32_t outcome;
-  uint32_t samplePosition = sampleNb * frequency;
-
-  // variable uses only 1 period
-  samplePosition = samplePosition % (2 * squareLimit);
 
   // Calculates the output (-1 or +1)
   outcome = (1 << FQ12Notation);
 
-  if (samplePosition >= squareLimit)
+  if (phase >= squareLimit)
   {
     // Checks whether the output of the wave should be negative
     outcome = -outcome;
@@ -55,31 +41,32 @@ int32_t Waveform_Square(const uint16_t frequency, const uint16_t sampleNb)
   return outcome;
 }
 
-/*! @brief Sets up the waveforms for the sawtooth waveform.
+/*! @brief Calculates the digital output of the pulse waveform.
  *
- *  @param sampleFrequency The samples taken at the particular frequency.
- *  @return void.
+ *  @param phase The position in the period, where 2^32 is a full period.
+ *  @param dutyLimit The phase at which the pulse goes low.
+ *  @return int32_t - The output in Q notation with 12 decimal accuracy.
  */
-void Sawtooth_Init(const uint16_t sampleFrequency)
+int32_t Waveform_Pulse(const uint32_t phase, const uint32_t dutyLimit)
 {
-  sawtoothLimit = (sampleFrequency) << FQ12Notation;
+  // High for the first part of the period, the same single compare as the square wave
+  if (phase < dutyLimit)
+    return (1 << FQ12Notation);
+
+  return -(1 << FQ12Notation);
 }
 
 /*! @brief Calculates the digital output of the sawtooth waveform.
  *
- *  @param frequency The frequency in Q notation with 12 decimal accuracy.
- *  @param sampleNb The module clock rate in Hz.
+ *  @param phase The position in the period, where 2^32 is a full period.
+ *  @return int32_t - The output in Q notation with 12 decimal accuracy.
  */
-int32_t Waveform_Sawtooth(const uint16_t frequency, const uint16_t sampleNb)
+int32_t Waveform_Sawtooth(const uint32_t phase)
 {
   int32_t outcome;
-  uint32_t samplePosition = sampleNb * frequency;
-
-  // Variable uses only 1 period
-  samplePosition = samplePosition % sawtoothLimit;
 
-  // Calculates the output with the current sample position
-  outcome = (2 * samplePosition) / (sawtoothLimit >> FQ12Notation);
+  // The top bits of the phase ramp from 0 to 2 in Q12 over one period
+  outcome = (int32_t)(phase >> (PHASE_BITS - FQ12Notation - 1));
   // Result is calculated with
   outcome -= (1 << FQ12Notation);
 
@@ -13,32 +13,26 @@
 // New types
 #include "types.h"
 
-/*! @brief Sets up the waveforms for the square waveform.
- *
- *  @param sampleFrequency The samples taken at the particular frequency.
- *  @return void.
- */
-void Square_Init(const uint16_t sampleFrequency);
-
 /*! @brief Calculates the digital output of the square waveform.
  *
- *  @param frequency The frequency in Q notation with 12 decimal accuracy.
- *  @param sampleNb The module clock rate in Hz.
+ *  @param phase The position in the period, where 2^32 is a full period.
+ *  @return int32_t - The output in Q notation with 12 decimal accuracy.
  */
-int32_t Waveform_Square(const uint16_t frequency, const uint16_t sampleNb);
+int32_t Waveform_Square(const uint32_t phase);
 
-/*! @brief Sets up the waveforms for the sawtooth waveform.
+/*! @brief Calculates the digital output of the pulse waveform.
  *
- *  @param sampleFrequency The samples taken at the particular frequency.
- *  @return void.
+ *  @param phase The position in the period, where 2^32 is a full period.
+ *  @param dutyLimit The phase at which the pulse goes low.
+ *  @return int32_t - The output in Q notation with 12 decimal accuracy.
  */
-void Sawtooth_Init(const uint16_t sampleFrequency);
+int32_t Waveform_Pulse(const uint32_t phase, const uint32_t dutyLimit);
 
 /*! @brief Calculates the digital output of the sawtooth waveform.
  *
- *  @param frequency The frequency in Q notation with 12 decimal accuracy.
- *  @param sampleNb The module clock rate in Hz.
+ *  @param phase The position in the period, where 2^32 is a full period.
+ *  @return int32_t - The output in Q notation with 12 decimal accuracy.
  */
-int32_t Waveform_Sawtooth(const uint16_t frequency, const uint16_t sampleNb);
+int32_t Waveform_Sawtooth(const uint32_t phase);
 
 #endif
@@ -0,0 +1,171 @@
+/*! @file
+ *
+ *  @brief Host model of UART2 and its eDMA channels for the tests.
+ *
+ *  Implementation of the simulated registers, and of the parts of the eDMA and UART2 the UART
+ *  module relies on: the receive DMA writing round the receive ring and interrupting at each
+ *  half, the idle line interrupt, and the transmit DMA sending one frame per request.
+ *
+ *  @author Mohammad Yasin Azimi
+ *  @date 2016-11-09
+ */
+#include <string.h>
+#include "OS.h"
+#include "UART.h"
+#include "MK70F12.h"
+
+// The eDMA channels the UART module uses
+#define HOST_RX_CHANNEL 0
+#define HOST_TX_CHANNEL 1
+
+struct UART_MemMap HostUART2;
+struct DMA_MemMap HostDMA;
+struct DMAMUX_MemMap HostDMAMUX0;
+struct SIM_MemMap HostSIM;
+struct PORT_MemMap HostPORTE;
+struct NVIC_MemMap HostNVIC;
+
+uint8_t HostUART_Sent[HOST_UART_SENT_SIZE];
+uint32_t HostUART_NbSent;
+
+/*! @brief Runs the DMA ISR and clears the interrupt requests it acknowledged.
+ *
+ *  @return void.
+ */
+static void DMAISR(void)
+{
+  UART_DMAISR();
+  HostDMA.INT = 0;
+}
+
+/*! @brief Runs the UART2 ISR and clears the idle flag it acknowledged.
+ *
+ *  @return void.
+ */
+static void IdleISR(void)
+{
+  UART_ISR();
+  HostUART2.S1 &= ~UART_S1_IDLE_MASK;
+}
+
+/*! @brief Acts on a write to DMA_SERQ since the model last ran.
+ *
+ *  @return void.
+ */
+static void SetRequests(void)
+{
+  if (!(HostDMA.SERQ & DMA_SERQ_NOP_MASK))
+  {
+    HostDMA.ERQ |= 1u << (HostDMA.SERQ & DMA_SERQ_SERQ_MASK);
+    HostDMA.SERQ = DMA_SERQ_NOP_MASK;
+  }
+}
+
+/*! @brief Counts one minor loop of a channel and raises its interrupts.
+ *
+ *  @param channel The eDMA channel.
+ *  @return void.
+ */
+static void MinorLoopDone(const uint8_t channel)
+{
+  uint16_t citer = HostDMA.TCD[channel].CITER_ELINKNO & DMA_CITER_ELINKNO_CITER_MASK;
+  uint16_t biter = HostDMA.TCD[channel].BITER_ELINKNO & DMA_BITER_ELINKNO_BITER_MASK;
+  uint16_t csr = HostDMA.TCD[channel].CSR;
+  uint8_t interrupt;
+
+  // The count is updated before the interrupt is raised, so the ISR sees the transfer done
+  citer--;
+  interrupt = (citer == biter / 2) && (csr & DMA_CSR_INTHALF_MASK);
+  if (citer == 0)
+  {
+    // The major loop is done, so the addresses are adjusted and the count reloaded
+    HostDMA.TCD[channel].SADDR += HostDMA.TCD[channel].SLAST;
+    HostDMA.TCD[channel].DADDR += HostDMA.TCD[channel].DLAST_SGA;
+    HostDMA.TCD[channel].CSR |= DMA_CSR_DONE_MASK;
+    if (csr & DMA_CSR_DREQ_MASK)
+      HostDMA.ERQ &= ~(1u << channel);
+    citer = biter;
+    interrupt = (csr & DMA_CSR_INTMAJOR_MASK) != 0;
+  }
+  HostDMA.TCD[channel].CITER_ELINKNO = citer;
+
+  if (interrupt)
+  {
+    HostDMA.INT |= 1u << channel;
+    HostOS_Interrupt(DMAISR);
+  }
+}
+
+void HostUART_Reset(void)
+{
+  memset(&HostUART2, 0, sizeof(HostUART2));
+  memset(&HostDMA, 0, sizeof(HostDMA));
+  memset(&HostDMAMUX0, 0, sizeof(HostDMAMUX0));
+  memset(&HostSIM, 0, sizeof(HostSIM));
+  memset(&HostPORTE, 0, sizeof(HostPORTE));
+  memset(&HostNVIC, 0, sizeof(HostNVIC));
+
+  // UART2 has single word FIFOs, and the transmitter is idle
+  HostUART2.BDL = 0x04;
+  HostUART2.S1 = UART_S1_TDRE_MASK | UART_S1_TC_MASK;
+  HostDMA.SERQ = DMA_SERQ_NOP_MASK;
+  HostUART_NbSent = 0;
+}
+
+void HostUART_Receive(const uint8_t data[], const uint16_t length)
+{
+  for (uint16_t byte = 0; byte < length; byte++)
+  {
+    SetRequests();
+    if (!(HostUART2.C2 & UART_C2_RE_MASK) || !(HostUART2.C5 & UART_C5_RDMAS_MASK) || !(HostUART2.C2 & UART_C2_RIE_MASK)
+	|| !(HostDMAMUX0.CHCFG[HOST_RX_CHANNEL] & DMAMUX_CHCFG_ENBL_MASK) || !(HostDMA.ERQ & (1u << HOST_RX_CHANNEL)))
+      continue;
+
+    *(uint8_t*)(uintptr_t)HostDMA.TCD[HOST_RX_CHANNEL].DADDR = data[byte];
+    HostDMA.TCD[HOST_RX_CHANNEL].DADDR += (int16_t)HostDMA.TCD[HOST_RX_CHANNEL].DOFF;
+    MinorLoopDone(HOST_RX_CHANNEL);
+  }
+}
+
+void HostUART_Idle(void)
+{
+  if (!(HostUART2.C2 & UART_C2_ILIE_MASK))
+    return;
+
+  HostUART2.S1 |= UART_S1_IDLE_MASK;
+  HostOS_Interrupt(IdleISR);
+}
+
+uint16_t HostUART_Transmit(const uint16_t nbBytes)
+{
+  uint16_t sent = 0;
+  uint8_t data;
+
+  for (;;)
+  {
+    SetRequests();
+    if (!(HostUART2.C2 & UART_C2_TE_MASK) || !(HostUART2.C5 & UART_C5_TDMAS_MASK) || !(HostUART2.C2 & UART_C2_TIE_MASK)
+	|| !(HostDMAMUX0.CHCFG[HOST_TX_CHANNEL] & DMAMUX_CHCFG_ENBL_MASK) || !(HostDMA.ERQ & (1u << HOST_TX_CHANNEL)))
+    {
+      HostUART2.S1 |= UART_S1_TC_MASK;
+      return sent;
+    }
+
+    HostUART2.S1 &= ~UART_S1_TC_MASK;
+    if (sent == nbBytes)
+      return sent;
+
+    data = *(uint8_t*)(uintptr_t)HostDMA.TCD[HOST_TX_CHANNEL].SADDR;
+    HostDMA.TCD[HOST_TX_CHANNEL].SADDR += (int16_t)HostDMA.TCD[HOST_TX_CHANNEL].SOFF;
+    if (HostUART_NbSent < HOST_UART_SENT_SIZE)
+      HostUART_Sent[HostUART_NbSent] = data;
+    HostUART_NbSent++;
+    sent++;
+    MinorLoopDone(HOST_TX_CHANNEL);
+  }
+}
+
+uint32_t HostUART_Divisor(void)
+{
+  return (((uint32_t)(HostUART2.BDH & UART_BDH_SBR_MASK) << 8 | HostUART2.BDL) << 5) | (HostUART2.C4 & UART_C4_BRFA_MASK);
+}
@@ -0,0 +1,87 @@
+/*! @file
+ *
+ *  @brief Host build of the K70 peripheral registers for the tests.
+ *
+ *  This includes the target MK70F12.h and points the peripherals the UART module uses at
+ *  simulated registers in memory. A model of UART2 and its two eDMA channels stands in for the
+ *  hardware: it moves received bytes into memory the way the receive DMA does, sends frames
+ *  from memory the way the transmit DMA does, and raises the ISRs.
+ *
+ *  Registers that are cleared by writing to them, such as DMA_CINT and the IDLE flag, are
+ *  cleared by the model when the ISR that acknowledged them returns, and a write to DMA_SERQ
+ *  takes effect the next time the model runs.
+ *
+ *  @author Mohammad Yasin Azimi
+ *  @date 2016-11-09
+ */
+#ifndef HOST_MK70F12_H
+#define HOST_MK70F12_H
+
+#include <stdint.h>
+#include "../../Static_Code/IO_Map/MK70F12.h"
+
+extern struct UART_MemMap HostUART2;
+extern struct DMA_MemMap HostDMA;
+extern struct DMAMUX_MemMap HostDMAMUX0;
+extern struct SIM_MemMap HostSIM;
+extern struct PORT_MemMap HostPORTE;
+extern struct NVIC_MemMap HostNVIC;
+
+#undef UART2_BASE_PTR
+#undef DMA_BASE_PTR
+#undef DMAMUX0_BASE_PTR
+#undef SIM_BASE_PTR
+#undef PORTE_BASE_PTR
+#undef NVIC_BASE_PTR
+#define UART2_BASE_PTR   ((UART_MemMapPtr)&HostUART2)
+#define DMA_BASE_PTR     ((DMA_MemMapPtr)&HostDMA)
+#define DMAMUX0_BASE_PTR ((DMAMUX_MemMapPtr)&HostDMAMUX0)
+#define SIM_BASE_PTR     ((SIM_MemMapPtr)&HostSIM)
+#define PORTE_BASE_PTR   ((PORT_MemMapPtr)&HostPORTE)
+#define NVIC_BASE_PTR    ((NVIC_MemMapPtr)&HostNVIC)
+
+// The bytes the model keeps of what has been sent
+#define HOST_UART_SENT_SIZE 65536
+
+extern uint8_t HostUART_Sent[HOST_UART_SENT_SIZE];	/*!< The bytes sent since HostUART_Reset, as far as they fit */
+extern uint32_t HostUART_NbSent;			/*!< The number of bytes sent since HostUART_Reset, which a test may set back to 0 */
+
+/*! @brief Puts the simulated registers in their reset state.
+ *
+ *  @return void.
+ *  @note Called before UART_Init.
+ */
+void HostUART_Reset(void);
+
+/*! @brief Receives bytes on the UART2 line.
+ *
+ *  Each byte is moved by the receive DMA, which interrupts at half and at major loop completion.
+ *  @param data The bytes.
+ *  @param length The number of bytes.
+ *  @return void.
+ *  @note Bytes are lost if the receiver or the receive DMA request is not enabled.
+ */
+void HostUART_Receive(const uint8_t data[], const uint16_t length);
+
+/*! @brief Lets the UART2 receive line go idle, raising the idle line interrupt if it is enabled.
+ *
+ *  @return void.
+ */
+void HostUART_Idle(void);
+
+/*! @brief Sends bytes from the transmit DMA onto the UART2 line.
+ *
+ *  A transfer is started by a write to DMA_SERQ, and raises the DMA interrupt when its major
+ *  loop completes.
+ *  @param nbBytes The most bytes to send, a character time each.
+ *  @return uint16_t - The number of bytes sent.
+ */
+uint16_t HostUART_Transmit(const uint16_t nbBytes);
+
+/*! @brief Gets the baud rate divisor written to UART2.
+ *
+ *  @return uint32_t - 32 * SBR + BRFA.
+ */
+uint32_t HostUART_Divisor(void);
+
+#endif
@@ -0,0 +1,131 @@
+/*! @file
+ *
+ *  @brief Host build of the OS for the tests.
+ *
+ *  Implementation of the OS calls used by the modules under test, for one thread. A wait that
+ *  cannot be satisfied at once runs the idle function a clock tick at a time until it can.
+ *
+ *  @author Mohammad Yasin Azimi
+ *  @date 2016-11-09
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "OS.h"
+
+// The ticks a wait forever is given before the test is taken to have deadlocked
+#define HOST_OS_DEADLOCK_TICKS 1000000
+
+// The simulated interrupts that can be waiting for interrupts to be unmasked
+#define HOST_OS_NB_PENDING 16
+
+uint32_t HostOS_NbKernelCalls;
+
+static OS_ECB Events[OS_MAX_EVENTS];
+static uint8_t NbEvents;
+static uint32_t Time;
+static bool Masked;
+static void (*Pending[HOST_OS_NB_PENDING])(void);
+static uint8_t NbPending;
+static void (*Idle)(void);
+
+void HostOS_DisableInterrupts(void)
+{
+  Masked = true;
+}
+
+void HostOS_EnableInterrupts(void)
+{
+  Masked = false;
+  for (uint8_t isrNb = 0; isrNb < NbPending; isrNb++)
+    Pending[isrNb]();
+  NbPending = 0;
+}
+
+void HostOS_Interrupt(void (*isr)(void))
+{
+  if (!Masked)
+  {
+    isr();
+    return;
+  }
+
+  for (uint8_t isrNb = 0; isrNb < NbPending; isrNb++)
+    if (Pending[isrNb] == isr)
+      return;
+  Pending[NbPending++] = isr;
+}
+
+void HostOS_SetIdle(void (*idle)(void))
+{
+  Idle = idle;
+}
+
+void OS_ISREnter(void)
+{
+}
+
+void OS_ISRExit(void)
+{
+}
+
+OS_ECB* OS_SemaphoreCreate(const uint32_t value)
+{
+  if (NbEvents >= OS_MAX_EVENTS)
+    return NULL;
+
+  Events[NbEvents].count = value;
+  Events[NbEvents].waitList = 0;
+
+  return &Events[NbEvents++];
+}
+
+OS_ERROR OS_SemaphoreSignal(OS_ECB* const pEvent)
+{
+  HostOS_NbKernelCalls++;
+  pEvent->count++;
+
+  return OS_NO_ERROR;
+}
+
+OS_ERROR OS_SemaphoreWait(OS_ECB* const pEvent, const uint32_t timeout)
+{
+  uint32_t ticks = 0;
+
+  HostOS_NbKernelCalls++;
+  while (pEvent->count == 0)
+  {
+    if (!Idle || (timeout && (ticks >= timeout)))
+      return OS_TIMEOUT;
+    if (!timeout && (ticks >= HOST_OS_DEADLOCK_TICKS))
+    {
+      fprintf(stderr, "OS_SemaphoreWait: deadlocked\n");
+      exit(EXIT_FAILURE);
+    }
+    Idle();
+    Time++;
+    ticks++;
+  }
+  pEvent->count--;
+
+  return OS_NO_ERROR;
+}
+
+void OS_TimeDelay(const uint32_t ticks)
+{
+  for (uint32_t tick = 0; tick < ticks; tick++)
+  {
+    if (Idle)
+      Idle();
+    Time++;
+  }
+}
+
+uint32_t OS_TimeGet(void)
+{
+  return Time;
+}
+
+void OS_TimeSet(const uint32_t ticks)
+{
+  Time = ticks;
+}
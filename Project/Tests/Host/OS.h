@@ -0,0 +1,54 @@
+/*! @file
+ *
+ *  @brief Host build of the OS interface for the tests.
+ *
+ *  This includes the target OS.h and replaces the interrupt masking, which only has a meaning on
+ *  the K70. Simulated ISRs are raised through HostOS_Interrupt, and run at once or when
+ *  interrupts are next enabled, as they would on the target.
+ *
+ *  @author Mohammad Yasin Azimi
+ *  @date 2016-11-09
+ */
+#ifndef HOST_OS_H
+#define HOST_OS_H
+
+#include "../../Library/OS.h"
+
+#undef OS_DisableInterrupts
+#undef OS_EnableInterrupts
+#define OS_DisableInterrupts() HostOS_DisableInterrupts()
+#define OS_EnableInterrupts()  HostOS_EnableInterrupts()
+
+// The number of semaphore calls made, to count kernel calls in benchmarks
+extern uint32_t HostOS_NbKernelCalls;
+
+/*! @brief Masks the simulated interrupts.
+ *
+ *  @return void.
+ */
+void HostOS_DisableInterrupts(void);
+
+/*! @brief Unmasks the simulated interrupts and runs any raised while they were masked.
+ *
+ *  @return void.
+ */
+void HostOS_EnableInterrupts(void);
+
+/*! @brief Raises a simulated interrupt.
+ *
+ *  @param isr The interrupt service routine.
+ *  @return void.
+ *  @note The ISR runs at once unless interrupts are masked, and then when they are unmasked.
+ */
+void HostOS_Interrupt(void (*isr)(void));
+
+/*! @brief Sets the function called while a thread waits on a semaphore.
+ *
+ *  The function stands in for the rest of the system, such as hardware raising interrupts,
+ *  and is called once per clock tick of the wait.
+ *  @param idle The function, or NULL to let a wait time out at once.
+ *  @return void.
+ */
+void HostOS_SetIdle(void (*idle)(void));
+
+#endif
@@ -0,0 +1,234 @@
+/*! @file
+ *
+ *  @brief Kernel calls per byte through the FIFO on the host OS.
+ *
+ *  Moves blocks of each size through a FIFO and counts the semaphore calls made, for the
+ *  FIFO as it was (a counting semaphore per byte on each side), for FIFO_Put and FIFO_Get a
+ *  byte at a time, and for FIFO_PutBlock and FIFO_GetBlock. Each is run with the getter finding
+ *  the bytes already there, and with the getter waiting until the putter runs.
+ *
+ *  @author Mohammad Yasin Azimi
+ *  @date 2016-11-09
+ */
+#include "check.h"
+#include "OS.h"
+#include "FIFO.h"
+
+// The bytes moved for each count
+#define NB_BYTES 40960u
+
+// The length of a packet, which the packet thread gets as one block
+#define PACKET_LENGTH 5
+
+// The least the blocks must cut the kernel calls per byte of a packet by
+#define MIN_REDUCTION 4.0
+
+/*!
+ * @struct TOldFIFO
+ */
+typedef struct
+{
+  uint16_t Start;		/*!< The index of the position of the oldest data in the FIFO */
+  uint16_t End;			/*!< The index of the next available empty position in the FIFO */
+  uint16_t NbBytes;		/*!< The number of bytes currently stored in the FIFO */
+  uint8_t Buffer[FIFO_SIZE];	/*!< The actual array of bytes to store the data */
+  OS_ECB *BufferAccess;		/*!< Pointer for access to the buffer in FIFO */
+  OS_ECB *SpaceAvailable;	/*!< Counts the free bytes in FIFO */
+  OS_ECB *ItemsAvailable;	/*!< Counts the bytes in FIFO */
+} TOldFIFO;
+
+/*!
+ * @enum TMethod
+ */
+typedef enum
+{
+  METHOD_OLD,			/*!< The FIFO as it was, a byte at a time */
+  METHOD_BYTE,			/*!< FIFO_Put and FIFO_Get */
+  METHOD_BLOCK			/*!< FIFO_PutBlock and FIFO_GetBlock */
+} TMethod;
+
+static TOldFIFO OldFIFO;		/*!< The FIFO as it was */
+static TFIFO FIFO;			/*!< The FIFO */
+static TMethod Method;			/*!< How the bytes are moved */
+static const uint8_t* Pending;		/*!< The block the putter has not yet put, or NULL */
+static uint16_t PendingLength;		/*!< The length of that block */
+
+/*! @brief The FIFO as it was before blocks, which the counts are compared with.
+ *
+ *  @param FIFO A pointer to the FIFO that needs initializing.
+ *  @return void.
+ */
+static void OldFIFO_Init(TOldFIFO* const FIFO)
+{
+  FIFO->BufferAccess = OS_SemaphoreCreate(1);
+  FIFO->SpaceAvailable = OS_SemaphoreCreate(FIFO_SIZE);
+  FIFO->ItemsAvailable = OS_SemaphoreCreate(0);
+  FIFO->Start = 0;
+  FIFO->End = 0;
+  FIFO->NbBytes = 0;
+}
+
+/*! @brief Puts one byte into the FIFO as it was.
+ *
+ *  @param FIFO A pointer to the FIFO.
+ *  @param data The byte.
+ *  @return void.
+ */
+static void OldFIFO_Put(TOldFIFO* const FIFO, const uint8_t data)
+{
+  (void)OS_SemaphoreWait(FIFO->SpaceAvailable, 0);
+  (void)OS_SemaphoreWait(FIFO->BufferAccess, 0);
+  FIFO->Buffer[FIFO->End] = data;
+  FIFO->NbBytes++;
+  FIFO->End = (FIFO->End + 1) % FIFO_SIZE;
+  OS_SemaphoreSignal(FIFO->BufferAccess);
+  OS_SemaphoreSignal(FIFO->ItemsAvailable);
+}
+
+/*! @brief Gets one byte from the FIFO as it was.
+ *
+ *  @param FIFO A pointer to the FIFO.
+ *  @param dataPtr Where the byte is placed.
+ *  @return void.
+ */
+static void OldFIFO_Get(TOldFIFO* const FIFO, uint8_t* const dataPtr)
+{
+  (void)OS_SemaphoreWait(FIFO->ItemsAvailable, 0);
+  (void)OS_SemaphoreWait(FIFO->BufferAccess, 0);
+  *dataPtr = FIFO->Buffer[FIFO->Start];
+  FIFO->NbBytes--;
+  FIFO->Start = (FIFO->Start + 1) % FIFO_SIZE;
+  OS_SemaphoreSignal(FIFO->BufferAccess);
+  OS_SemaphoreSignal(FIFO->SpaceAvailable);
+}
+
+/*! @brief Puts a block the way the method does.
+ *
+ *  @param data The block.
+ *  @param length The length of the block.
+ *  @return void.
+ */
+static void Put(const uint8_t data[], const uint16_t length)
+{
+  switch (Method)
+  {
+    case METHOD_OLD:
+      for (uint16_t byte = 0; byte < length; byte++)
+	OldFIFO_Put(&OldFIFO, data[byte]);
+      break;
+    case METHOD_BYTE:
+      for (uint16_t byte = 0; byte < length; byte++)
+	FIFO_Put(&FIFO, data[byte]);
+      break;
+    default:
+      FIFO_PutBlock(&FIFO, data, length);
+      break;
+  }
+}
+
+/*! @brief Gets a block the way the method does.
+ *
+ *  @param data Where the block is placed.
+ *  @param length The length of the block.
+ *  @return void.
+ */
+static void Get(uint8_t data[], const uint16_t length)
+{
+  switch (Method)
+  {
+    case METHOD_OLD:
+      for (uint16_t byte = 0; byte < length; byte++)
+	OldFIFO_Get(&OldFIFO, &data[byte]);
+      break;
+    case METHOD_BYTE:
+      for (uint16_t byte = 0; byte < length; byte++)
+	FIFO_Get(&FIFO, &data[byte]);
+      break;
+    default:
+      FIFO_GetBlock(&FIFO, data, length);
+      break;
+  }
+}
+
+/*! @brief Runs the putter while the getter waits, as the OS would switch to it.
+ *
+ *  @return void.
+ */
+static void Putter(void)
+{
+  const uint8_t* const data = Pending;
+
+  if (!data)
+    return;
+  Pending = NULL;
+  Put(data, PendingLength);
+}
+
+/*! @brief Moves NB_BYTES through the FIFO in blocks and counts the kernel calls.
+ *
+ *  @param method How the bytes are moved.
+ *  @param length The length of each block.
+ *  @param waiting TRUE for the getter to wait for each block, FALSE to find it there.
+ *  @return double - The kernel calls per byte, or -1 if the bytes came out wrong.
+ *  @note Each run leaves the FIFOs empty, so they are initialized once.
+ */
+static double CallsPerByte(const TMethod method, const uint16_t length, const BOOL waiting)
+{
+  uint8_t in[FIFO_SIZE], out[FIFO_SIZE];
+  uint32_t nbWrong = 0;
+
+  Method = method;
+  HostOS_SetIdle(waiting ? Putter : NULL);
+  HostOS_NbKernelCalls = 0;
+
+  for (uint32_t position = 0; position < NB_BYTES; position += length)
+  {
+    for (uint16_t byte = 0; byte < length; byte++)
+      in[byte] = (uint8_t)(position + byte + (position >> 8));
+
+    if (waiting)
+    {
+      Pending = in;
+      PendingLength = length;
+    }
+    else
+      Put(in, length);
+    Get(out, length);
+
+    for (uint16_t byte = 0; byte < length; byte++)
+      nbWrong += (out[byte] != in[byte]);
+  }
+
+  HostOS_SetIdle(NULL);
+  CHECK(nbWrong == 0, "%u bytes wrong in blocks of %u", nbWrong, length);
+  return nbWrong ? -1 : (double)HostOS_NbKernelCalls / NB_BYTES;
+}
+
+int main(void)
+{
+  const uint16_t lengths[] = {1, PACKET_LENGTH, 32, FIFO_SIZE / 2};
+  double old, byte, block;
+
+  // The host OS has semaphores for few FIFOs
+  OldFIFO_Init(&OldFIFO);
+  FIFO_Init(&FIFO);
+
+  for (uint8_t waiting = bFALSE; waiting <= bTRUE; waiting++)
+  {
+    printf("  %s\n  block   as it was  FIFO_Put/Get  FIFO_PutBlock/GetBlock  calls per byte\n",
+	   waiting ? "getter waiting for each block" : "bytes already in the FIFO");
+    for (uint8_t lengthNb = 0; lengthNb < sizeof(lengths) / sizeof(lengths[0]); lengthNb++)
+    {
+      old = CallsPerByte(METHOD_OLD, lengths[lengthNb], waiting);
+      byte = CallsPerByte(METHOD_BYTE, lengths[lengthNb], waiting);
+      block = CallsPerByte(METHOD_BLOCK, lengths[lengthNb], waiting);
+      printf("  %5u %11.2f %13.2f %23.2f\n", lengths[lengthNb], old, byte, block);
+
+      if (lengths[lengthNb] == PACKET_LENGTH)
+	CHECK(old >= MIN_REDUCTION * block, "%s: packets take %.2f calls per byte, was %.2f",
+	      waiting ? "waiting" : "not waiting", block, old);
+    }
+  }
+
+  return CHECK_DONE("fifo_calls");
+}
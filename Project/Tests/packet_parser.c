@@ -0,0 +1,159 @@
+/*! @file
+ *
+ *  @brief Receive parser for 5-byte packets and extended frames.
+ *
+ *  Feeds byte streams to the packet module through a stand-in for the UART receive ring, and
+ *  checks what Packet_Get hands to the packet thread.
+ *
+ *  @author Mohammad Yasin Azimi
+ *  @date 2016-11-09
+ */
+#include "check.h"
+#include "crc.h"
+#include "UART.h"
+#include "packet.h"
+
+static uint8_t Stream[4096];		/*!< The bytes received */
+static uint16_t StreamLength;		/*!< The number of bytes received */
+static uint16_t StreamPosition;		/*!< The number of bytes the parser has consumed */
+static void (*Received)(void*);		/*!< The parser's receive callback */
+static uint8_t Sent[UART_FRAME_MAX];	/*!< The last frame sent */
+static uint16_t SentLength;		/*!< The length of the last frame sent */
+
+BOOL UART_Init(const uint32_t baudRate, const uint32_t moduleClk, void (*userFunction)(void*), void* userArguments)
+{
+  Received = userFunction;
+  return bTRUE;
+}
+
+uint16_t UART_InCount(void)
+{
+  return StreamLength - StreamPosition;
+}
+
+uint8_t UART_InPeek(const uint16_t offset)
+{
+  return Stream[StreamPosition + offset];
+}
+
+void UART_InSkip(const uint16_t length)
+{
+  StreamPosition += length;
+}
+
+uint8_t* UART_OutReserve(const uint16_t length, const TUARTClass class)
+{
+  SentLength = length;
+  return Sent;
+}
+
+void UART_OutCommit(uint8_t* const frame)
+{
+}
+
+/*! @brief Appends a 5-byte packet to the stream.
+ *
+ *  @param checksum The XOR of the packet, as sent.
+ *  @return void.
+ */
+static void AddPacket(const uint8_t command, const uint8_t parameter1, const uint8_t parameter2, const uint8_t parameter3, const uint8_t checksum)
+{
+  const uint8_t bytes[] = {command, parameter1, parameter2, parameter3, checksum};
+
+  for (uint8_t byte = 0; byte < sizeof(bytes); byte++)
+    Stream[StreamLength++] = bytes[byte];
+}
+
+/*! @brief Appends an extended frame to the stream.
+ *
+ *  @param type The frame's type.
+ *  @param length The number of payload bytes, which count up from the type.
+ *  @param corrupt TRUE to corrupt a payload byte after the CRC has been worked out.
+ *  @return void.
+ */
+static void AddFrame(const uint8_t type, const uint16_t length, const BOOL corrupt)
+{
+  const uint16_t start = StreamLength;
+  uint16_t crc;
+
+  Stream[StreamLength++] = PACKET_FRAME_SYNC1;
+  Stream[StreamLength++] = PACKET_FRAME_SYNC2;
+  Stream[StreamLength++] = type;
+  Stream[StreamLength++] = (uint8_t)length;
+  Stream[StreamLength++] = (uint8_t)(length >> 8);
+  for (uint16_t byte = 0; byte < length; byte++)
+    Stream[StreamLength++] = (uint8_t)(type + byte);
+
+  crc = CRC_Block(&Stream[start + 2], length + PACKET_FRAME_HEADER - 2);
+  Stream[StreamLength++] = (uint8_t)(crc >> 8);
+  Stream[StreamLength++] = (uint8_t)crc;
+
+  if (corrupt)
+    Stream[start + PACKET_FRAME_HEADER] ^= 0x01;
+}
+
+/*! @brief Takes what the parser has queued.
+ *
+ *  @param records Set to a command for each packet, or 0x100 plus the type for each frame.
+ *  @return uint16_t - The number of records taken.
+ */
+static uint16_t TakeAll(uint16_t records[])
+{
+  uint16_t nbRecords = 0;
+
+  Received(NULL);
+  while (Packet_Get(1))
+  {
+    if (PacketFrame.length)
+    {
+      BOOL payloadOK = bTRUE;
+
+      for (uint16_t byte = 0; byte < PacketFrame.length; byte++)
+        payloadOK = payloadOK && (PacketFrame.payload[byte] == (uint8_t)(PacketFrame.type + byte));
+      CHECK(payloadOK, "frame 0x%02X payload damaged", PacketFrame.type);
+      records[nbRecords++] = 0x100 | PacketFrame.type;
+    }
+    else
+      records[nbRecords++] = Packet_Command;
+  }
+
+  return nbRecords;
+}
+
+int main(void)
+{
+  uint16_t records[64];
+  uint16_t nbRecords;
+  uint16_t crc;
+
+  (void)Packet_Init(115200, 60000000);
+
+  // The CRC-16/CCITT check value
+  crc = CRC_Block((const uint8_t*)"123456789", 9);
+  CHECK(crc == 0x29B1, "CRC of \"123456789\" is 0x%04X", crc);
+
+  // Packets and frames come out in the order they arrived
+  AddPacket(0x60, 1, 2, 3, 0x60 ^ 1 ^ 2 ^ 3);
+  AddFrame(0x01, PACKET_FRAME_MAX, bFALSE);
+  AddPacket(0x61, 4, 5, 6, 0x61 ^ 4 ^ 5 ^ 6);
+  AddFrame(0x02, 1, bFALSE);
+  nbRecords = TakeAll(records);
+  CHECK((nbRecords == 4) && (records[0] == 0x60) && (records[1] == 0x101) && (records[2] == 0x61) && (records[3] == 0x102),
+	"interleaved packets and frames: %u records", nbRecords);
+
+  // A frame that fails its CRC is dropped, and a packet brings the parser back into sync
+  AddFrame(0x03, 10, bTRUE);
+  AddPacket(0x62, 7, 8, 9, 0x62 ^ 7 ^ 8 ^ 9);
+  AddFrame(0x04, 3, bFALSE);
+  nbRecords = TakeAll(records);
+  CHECK((nbRecords == 2) && (records[0] == 0x62) && (records[1] == 0x104), "bad frame: %u records", nbRecords);
+
+  // Sync bytes in the parameters of a damaged packet must not start a frame that swallows the packets after it
+  AddPacket(0x00, PACKET_FRAME_SYNC1, PACKET_FRAME_SYNC2, 0x10, 0x40);
+  for (uint8_t packetNb = 0; packetNb < 40; packetNb++)
+    AddPacket(0x00, PACKET_FRAME_SYNC1, PACKET_FRAME_SYNC2, 0x10, PACKET_FRAME_SYNC1 ^ PACKET_FRAME_SYNC2 ^ 0x10);
+  nbRecords = TakeAll(records);
+  CHECK(nbRecords == 40, "packets holding sync bytes after a bad packet: %u of 40", nbRecords);
+
+  return CHECK_DONE("packet_parser");
+}
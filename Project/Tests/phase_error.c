@@ -0,0 +1,92 @@
+/*! @file
+ *
+ *  @brief Long-run phase error of the 16.16 frequency word.
+ *
+ *  Plays channels through AWG_Update for millions of samples at a range of frequencies and
+ *  sample rates, counting whole periods from the phase accumulator's wraps, and checks the phase
+ *  reached against the exact phase of the requested frequency. The error grows by less than one
+ *  accumulator step (2^-32 of a period) per sample, so the realised frequency is within
+ *  sampleFrequency / 2^32 Hz of the request, far under 1 mHz.
+ *
+ *  @author Mohammad Yasin Azimi
+ *  @date 2016-11-09
+ */
+#include <math.h>
+#include "check.h"
+#include "AWG.h"
+
+// Samples played per frequency
+#define NB_SAMPLES 10000000ULL
+
+// 1 mHz in 16.16 fixed point, rounded down
+#define ONE_MILLIHERTZ 65
+
+/*! @brief Plays a frequency and checks the phase it reaches.
+ *
+ *  @param sampleFrequency The sample frequency in Hz.
+ *  @param frequency The frequency in Hz in 16.16 fixed point.
+ *  @return void.
+ */
+static void PlayFrequency(const uint16_t sampleFrequency, const uint32_t frequency)
+{
+  TChannel channel = {0};
+  unsigned __int128 exact, played;
+  uint64_t periods = 0;
+  double errorPeriods, realised;
+
+  AWG_Init(sampleFrequency);
+  channel.active = bTRUE;
+  channel.mode = CONTINUOUS_MODE;
+  channel.buffer[0].waveformType = SQUARE_WAVE;
+  channel.buffer[0].frequency.l = frequency;
+  channel.buffer[0].phaseIncrement = AWG_PhaseIncrement(frequency);
+  channel.output = &channel.buffer[0];
+
+  for (uint64_t sample = 0; sample < NB_SAMPLES; sample++)
+  {
+    (void)AWG_Update(&channel);
+    if (channel.wrapped)
+      periods++;
+  }
+
+  // Phase in units of 2^-32 of a period: exactly frequency / 2^16 / sampleFrequency periods per sample
+  played = ((unsigned __int128)periods << 32) | channel.phase;
+  exact = ((unsigned __int128)NB_SAMPLES * frequency << 16) / sampleFrequency;
+
+  CHECK(played <= exact, "%u Hz, 0x%08X: the phase ran ahead", sampleFrequency, frequency);
+  CHECK(exact - played <= NB_SAMPLES, "%u Hz, 0x%08X: lost %.3g steps in %llu samples",
+	sampleFrequency, frequency, (double)(exact - played), NB_SAMPLES);
+
+  errorPeriods = (double)(exact - played) / 4294967296.0;
+  realised = (double)channel.buffer[0].phaseIncrement * sampleFrequency / 4294967296.0;
+  CHECK(fabs(realised - frequency / 65536.0) * 65536.0 < ONE_MILLIHERTZ,
+	"%u Hz, 0x%08X: realised %.9f Hz", sampleFrequency, frequency, realised);
+
+  printf("%5u Hz  %14.6f Hz  %6.2e periods behind after %llu samples (%.1f days)\n",
+	 sampleFrequency, frequency / 65536.0, errorPeriods, NB_SAMPLES,
+	 NB_SAMPLES / (double)sampleFrequency / 86400.0);
+}
+
+int main(void)
+{
+  static const uint16_t sampleFrequencies[] = {100, 1000, 48000, 65535};
+  static const double fractions[] = {1e-6, 0.001, 1.0 / 3.0, 0.123456789, 0.5, 1.0};
+
+  for (uint8_t rateNb = 0; rateNb < sizeof(sampleFrequencies) / sizeof(sampleFrequencies[0]); rateNb++)
+  {
+    const uint16_t sampleFrequency = sampleFrequencies[rateNb];
+    const uint32_t nyquist = (uint32_t)sampleFrequency << 15;
+
+    AWG_Init(sampleFrequency);
+    CHECK(AWG_FrequencyValid(nyquist), "%u Hz: Nyquist rejected", sampleFrequency);
+    CHECK(!AWG_FrequencyValid(nyquist + 1), "%u Hz: above Nyquist accepted", sampleFrequency);
+
+    // The smallest step of the frequency word still moves the phase
+    PlayFrequency(sampleFrequency, 1);
+
+    for (uint8_t fractionNb = 0; fractionNb < sizeof(fractions) / sizeof(fractions[0]); fractionNb++)
+      PlayFrequency(sampleFrequency, (uint32_t)(fractions[fractionNb] * nyquist));
+  }
+
+  return CHECK_DONE("phase_error");
+}
@@ -0,0 +1,229 @@
+/*! @file
+ *
+ *  @brief Lock-free ring buffer under a contended producer and consumer.
+ *
+ *  Runs a producer and a consumer thread against one ring, each mixing the single byte and
+ *  block calls, and checks every byte arrives once and in order. Then times bytes through the
+ *  ring with and without a mutex round each call, the mutex standing in for the critical
+ *  sections the ring replaced.
+ *
+ *  @author Mohammad Yasin Azimi
+ *  @date 2016-11-09
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <time.h>
+#include "check.h"
+#include "ring.h"
+
+// The bytes the stress test moves through the ring
+#define STRESS_BYTES 10000000u
+
+// The bytes each benchmark moves through the ring
+#define BENCHMARK_BYTES 8000000u
+
+/*!
+ * @struct TStress
+ */
+typedef struct
+{
+  TRing ring;			/*!< The ring shared by the threads */
+  uint32_t nbBytes;		/*!< The number of bytes to move */
+  uint16_t block;		/*!< The bytes moved per call, 0 to mix single bytes and blocks */
+  BOOL locked;			/*!< TRUE to take the mutex round each ring call */
+  pthread_mutex_t lock;		/*!< Stands in for a critical section */
+  uint32_t nbWrong;		/*!< The number of bytes the consumer got out of order */
+  uint32_t nbOverfull;		/*!< The number of times the consumer saw more than RING_SIZE bytes */
+} TStress;
+
+/*! @brief Gets the byte in a position of the stream.
+ *
+ *  The pattern does not repeat every RING_SIZE bytes, so a byte from the wrong lap shows up.
+ *  @param position The position in the stream.
+ *  @return uint8_t - The byte.
+ */
+static uint8_t StreamByte(const uint32_t position)
+{
+  return (uint8_t)(position * 7 + (position >> 8) + (position >> 16));
+}
+
+/*! @brief Gets the length of the next call, from a cheap pseudo-random sequence.
+ *
+ *  @param seed The state of the sequence.
+ *  @param block The fixed length, or 0 for a mix of single bytes and blocks up to half the ring.
+ *  @return uint16_t - The length, 1 for a single byte call.
+ */
+static uint16_t NextLength(uint32_t* const seed, const uint16_t block)
+{
+  if (block)
+    return block;
+
+  *seed = *seed * 1664525u + 1013904223u;
+  if (*seed & 0x80000000u)
+    return 1;
+  return (uint16_t)(1 + ((*seed >> 8) % (RING_SIZE / 2)));
+}
+
+/*! @brief Puts the stream into the ring.
+ *
+ *  @param arg The TStress.
+ *  @return void* - NULL.
+ */
+static void* Producer(void* arg)
+{
+  TStress* const stress = arg;
+  uint8_t data[RING_SIZE];
+  uint32_t position = 0, seed = 1;
+  uint16_t length;
+  BOOL put;
+
+  while (position < stress->nbBytes)
+  {
+    length = NextLength(&seed, stress->block);
+    if (length > stress->nbBytes - position)
+      length = (uint16_t)(stress->nbBytes - position);
+    for (uint16_t byte = 0; byte < length; byte++)
+      data[byte] = StreamByte(position + byte);
+
+    do
+    {
+      if (stress->locked)
+	pthread_mutex_lock(&stress->lock);
+      put = (length == 1) ? Ring_Put(&stress->ring, data[0]) : Ring_PutBlock(&stress->ring, data, length);
+      if (stress->locked)
+	pthread_mutex_unlock(&stress->lock);
+      if (!put)
+	sched_yield();
+    } while (!put);
+
+    position += length;
+  }
+
+  return NULL;
+}
+
+/*! @brief Takes the stream out of the ring and checks it.
+ *
+ *  Cycles through Ring_Get, Ring_GetBlock, Ring_Peek with Ring_Skip, and Ring_Contiguous with Ring_Skip.
+ *  @param arg The TStress.
+ *  @return void* - NULL.
+ */
+static void* Consumer(void* arg)
+{
+  TStress* const stress = arg;
+  uint8_t data[RING_SIZE];
+  const uint8_t* piece;
+  uint32_t position = 0, seed = 2;
+  uint16_t length, count;
+  uint8_t method = 0;
+
+  while (position < stress->nbBytes)
+  {
+    length = NextLength(&seed, stress->block);
+
+    if (stress->locked)
+      pthread_mutex_lock(&stress->lock);
+    count = Ring_Count(&stress->ring);
+    if (count > RING_SIZE)
+      stress->nbOverfull++;
+    if (stress->block || (length > 1))
+      method = (method + 1) % 3;
+    switch ((length == 1) && !stress->block ? 3 : method)
+    {
+      case 0:
+	count = Ring_GetBlock(&stress->ring, data, length);
+	break;
+      case 1:
+	if (count > length)
+	  count = length;
+	for (uint16_t byte = 0; byte < count; byte++)
+	  data[byte] = Ring_Peek(&stress->ring, byte);
+	Ring_Skip(&stress->ring, count);
+	break;
+      case 2:
+	count = Ring_Contiguous(&stress->ring, &piece);
+	if (count > length)
+	  count = length;
+	for (uint16_t byte = 0; byte < count; byte++)
+	  data[byte] = piece[byte];
+	Ring_Skip(&stress->ring, count);
+	break;
+      default:
+	count = Ring_Get(&stress->ring, data) ? 1 : 0;
+	break;
+    }
+    if (stress->locked)
+      pthread_mutex_unlock(&stress->lock);
+
+    if (count == 0)
+    {
+      sched_yield();
+      continue;
+    }
+
+    for (uint16_t byte = 0; byte < count; byte++)
+      if (data[byte] != StreamByte(position + byte))
+	stress->nbWrong++;
+    position += count;
+  }
+
+  return NULL;
+}
+
+/*! @brief Runs a producer and a consumer thread through a ring.
+ *
+ *  @param nbBytes The number of bytes to move.
+ *  @param block The bytes moved per call, 0 to mix single bytes and blocks.
+ *  @param locked TRUE to take a mutex round each ring call.
+ *  @param stress Where the counters are placed.
+ *  @return double - The nanoseconds taken per byte.
+ */
+static double Run(const uint32_t nbBytes, const uint16_t block, const BOOL locked, TStress* const stress)
+{
+  pthread_t producer, consumer;
+  struct timespec start, end;
+
+  Ring_Init(&stress->ring);
+  stress->nbBytes = nbBytes;
+  stress->block = block;
+  stress->locked = locked;
+  stress->nbWrong = 0;
+  stress->nbOverfull = 0;
+  pthread_mutex_init(&stress->lock, NULL);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  pthread_create(&consumer, NULL, Consumer, stress);
+  pthread_create(&producer, NULL, Producer, stress);
+  pthread_join(producer, NULL);
+  pthread_join(consumer, NULL);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  pthread_mutex_destroy(&stress->lock);
+
+  return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / nbBytes;
+}
+
+int main(void)
+{
+  static TStress stress;
+  const uint16_t blocks[] = {1, 5, 32, RING_SIZE / 2};
+  double lockFree, locked;
+
+  // Every call mixed, so each side sees the other mid-way through every kind of call
+  (void)Run(STRESS_BYTES, 0, bFALSE, &stress);
+  CHECK(stress.nbWrong == 0, "%u of %u bytes out of order", stress.nbWrong, STRESS_BYTES);
+  CHECK(stress.nbOverfull == 0, "more than RING_SIZE bytes seen %u times", stress.nbOverfull);
+
+  printf("  block   lock-free     mutex\n");
+  for (uint8_t blockNb = 0; blockNb < sizeof(blocks) / sizeof(blocks[0]); blockNb++)
+  {
+    lockFree = Run(BENCHMARK_BYTES / (blocks[blockNb] == 1 ? 4 : 1), blocks[blockNb], bFALSE, &stress);
+    CHECK(stress.nbWrong == 0, "%u bytes out of order in blocks of %u", stress.nbWrong, blocks[blockNb]);
+    locked = Run(BENCHMARK_BYTES / (blocks[blockNb] == 1 ? 4 : 1), blocks[blockNb], bTRUE, &stress);
+    CHECK(stress.nbWrong == 0, "%u bytes out of order in blocks of %u with a mutex", stress.nbWrong, blocks[blockNb]);
+    printf("  %5u %8.2f ns %7.2f ns per byte\n", blocks[blockNb], lockFree, locked);
+  }
+
+  return CHECK_DONE("ring_stress");
+}
@@ -0,0 +1,173 @@
+/*! @file
+ *
+ *  @brief Order of the halves of a sequence segment's 32-bit frequency.
+ *
+ *  Checks that any legal 16.16 frequency is accepted after any other when the low half is sent
+ *  and then the high half, that an illegal one leaves the segment unchanged, and that the phase
+ *  step follows the whole word. Also checks a channel plays its staged settings again once a
+ *  sequence has played out or been stopped, rather than the last segment.
+ *
+ *  @author Mohammad Yasin Azimi
+ *  @date 2016-11-09
+ */
+#include "check.h"
+#include "sequence.h"
+
+#define SAMPLE_FREQUENCY 100
+
+void Packet_Put(const uint8_t command, const uint8_t parameter1, const uint8_t parameter2, const uint8_t parameter3)
+{
+}
+
+/*! @brief Sends a 16.16 frequency to the selected segment, low half first.
+ *
+ *  @param sequence The sequence.
+ *  @param frequency The frequency in 16.16 fixed point.
+ *  @return BOOL - TRUE if both halves were accepted.
+ */
+static BOOL SendFrequency(TSequence* const sequence, const uint32_t frequency)
+{
+  const uint16union_t lo = {.l = (uint16_t)frequency};
+  const uint16union_t hi = {.l = (uint16_t)(frequency >> 16)};
+
+  return Sequence_Control(sequence, SEQUENCE_FREQUENCY_LO, lo) && Sequence_Control(sequence, SEQUENCE_FREQUENCY_HI, hi);
+}
+
+/*! @brief Sets up a channel playing a square wave, and a sequence of a sawtooth and a pulse.
+ *
+ *  @param channel The channel.
+ *  @param sequence The sequence.
+ *  @return void.
+ */
+static void Setup(TChannel* const channel, TSequence* const sequence)
+{
+  const TAWGSettings staged = {.waveformType = SQUARE_WAVE, .frequency.l = 5 << 16, .amplitude.l = 20000,
+			       .phaseIncrement = AWG_PhaseIncrement(5 << 16), .duty.l = 32768, .dutyLimit = 0x80000000};
+  uint16union_t data;
+
+  *channel = (TChannel){.settings = staged, .buffer[0] = staged, .output = &channel->buffer[0], .mode = CONTINUOUS_MODE};
+
+  Sequence_Init(sequence);
+  sequence->segments[0].output = staged;
+  sequence->segments[0].output.waveformType = SAWTOOTH_WAVE;
+  sequence->segments[0].duration.l = 10;
+  sequence->segments[1].output = staged;
+  sequence->segments[1].output.waveformType = PULSE_WAVE;
+  sequence->segments[1].output.amplitude.l = 5000;
+  sequence->segments[1].output.dutyLimit = 0x40000000;
+  sequence->segments[1].duration.l = 10;
+  data.l = 2;
+  (void)Sequence_Control(sequence, SEQUENCE_LENGTH_CHANGE, data);
+  data.l = 0;
+  CHECK(Sequence_Control(sequence, SEQUENCE_START, data), "sequence not started");
+}
+
+/*! @brief Runs the PIT thread's step for a number of samples.
+ *
+ *  @param channel The channel.
+ *  @param sequence The sequence.
+ *  @param nbSamples The number of samples.
+ *  @return void.
+ */
+static void Play(TChannel* const channel, TSequence* const sequence, const uint16_t nbSamples)
+{
+  for (uint16_t sampleNb = 0; sampleNb < nbSamples; sampleNb++)
+  {
+    if (sequence->running)
+      channel->active = Sequence_Step(sequence, channel);
+    if (channel->active)
+      (void)AWG_Update(channel);
+  }
+}
+
+/*! @brief Checks a channel plays its staged settings, from where its phase is.
+ *
+ *  @param channel The channel.
+ *  @param how What was done to the channel, for the report.
+ *  @return void.
+ */
+static void CheckStaged(TChannel* const channel, const char* const how)
+{
+  uint16_t nbWrong = 0;
+  uint32_t phase;
+  int16_t expected;
+
+  CHECK(channel->output->waveformType == SQUARE_WAVE, "%s: playing waveform %u, not the staged square wave", how, channel->output->waveformType);
+
+  // Restarted as CHANNEL_START does
+  channel->active = bTRUE;
+  for (uint16_t sampleNb = 0; sampleNb < 40; sampleNb++)
+  {
+    phase = channel->phase;
+    expected = AWG_Output(channel->settings, phase);
+    nbWrong += (AWG_Update(channel) != expected);
+  }
+  CHECK(nbWrong == 0, "%s: %u of 40 samples not from the staged settings", how, nbWrong);
+}
+
+/*! @brief Checks the staged settings are played again after a sequence plays out, and after one is stopped.
+ *
+ *  @return void.
+ */
+static void TestRelease(void)
+{
+  TSequence sequence;
+  TChannel channel;
+  uint16union_t data = {.l = 0};
+
+  Setup(&channel, &sequence);
+  Play(&channel, &sequence, 25);
+  CHECK(!sequence.running && !channel.active, "sequence still running after its segments");
+  CHECK(channel.output == &sequence.output, "sequence not played from its own buffer");
+  CHECK(channel.buffer[0].waveformType == SQUARE_WAVE, "sequence overwrote the channel's buffer");
+  Sequence_Release(&sequence, &channel);
+  CheckStaged(&channel, "played out");
+
+  Setup(&channel, &sequence);
+  Play(&channel, &sequence, 15);
+  CHECK(channel.output->waveformType == PULSE_WAVE, "second segment not playing");
+  Sequence_Release(&sequence, &channel);
+  CHECK(channel.output == &sequence.output, "channel released while its sequence runs");
+  CHECK(Sequence_Control(&sequence, SEQUENCE_STOP, data), "sequence not stopped");
+  channel.active = bFALSE;
+  Sequence_Release(&sequence, &channel);
+  CheckStaged(&channel, "stopped");
+}
+
+int main(void)
+{
+  static const uint32_t changes[][2] =
+  {
+    {50 << 16, (10 << 16) | 0x8000},	// 50.0 Hz to 10.5 Hz
+    {(10 << 16) | 0x8000, 50 << 16},	// 10.5 Hz to 50.0 Hz
+    {(49 << 16) | 0xFFFF, 1},		// Just under Nyquist to the smallest step
+    {1, 50 << 16}			// The smallest step to Nyquist
+  };
+  TSequence sequence;
+  uint32_t frequency;
+
+  AWG_Init(SAMPLE_FREQUENCY);
+
+  // Each half used to be checked against the other's old value, so these depended on the order sent
+  for (uint8_t changeNb = 0; changeNb < sizeof(changes) / sizeof(changes[0]); changeNb++)
+  {
+    Sequence_Init(&sequence);
+    CHECK(SendFrequency(&sequence, changes[changeNb][0]), "0x%08X not accepted", changes[changeNb][0]);
+    CHECK(SendFrequency(&sequence, changes[changeNb][1]), "0x%08X to 0x%08X rejected", changes[changeNb][0], changes[changeNb][1]);
+
+    frequency = sequence.segments[0].output.frequency.l;
+    CHECK(frequency == changes[changeNb][1], "0x%08X to 0x%08X gave 0x%08X", changes[changeNb][0], changes[changeNb][1], frequency);
+    CHECK(sequence.segments[0].output.phaseIncrement == AWG_PhaseIncrement(frequency), "phase step out of step with 0x%08X", frequency);
+  }
+
+  // A rejected word leaves the segment with its old frequency, not a mix of the halves
+  Sequence_Init(&sequence);
+  CHECK(SendFrequency(&sequence, (10 << 16) | 0x8000), "10.5 Hz not accepted");
+  CHECK(!SendFrequency(&sequence, (50 << 16) | 1), "just over Nyquist accepted");
+  CHECK(sequence.segments[0].output.frequency.l == ((10 << 16) | 0x8000), "a rejected frequency changed the segment");
+
+  // The staged settings are played again after a sequence plays out, and after one is stopped
+  TestRelease();
+
+  return CHECK_DONE("sequence_frequency");
+}
@@ -0,0 +1,267 @@
+/*! @file
+ *
+ *  @brief Transmit classes on a model of UART2 and its eDMA channels.
+ *
+ *  Checks the telemetry limit holds while a telemetry frame is on the wire, and measures each
+ *  class's queue depth, latency and drops with telemetry produced faster than the link sends it
+ *  and control responses in among it. The figures are those UART_CLASS_STATS reports. A baud rate
+ *  switch is checked to finish while telemetry keeps the link saturated.
+ *
+ *  @author Mohammad Yasin Azimi
+ *  @date 2016-11-09
+ */
+#include <stdio.h>
+#include <string.h>
+#include "check.h"
+#include "OS.h"
+#include "UART.h"
+#include "packet.h"
+#include "MK70F12.h"
+
+// The bus clock the UART runs from, and the baud rate UART_Init sets
+#define MODULE_CLK 25000000
+#define BAUD_RATE 115200
+
+// Bytes sent per clock tick, about 115200 baud at a 1 ms tick
+#define BYTES_PER_TICK 12
+
+// Clock ticks each load runs for
+#define NB_TICKS 10000
+
+// Clock ticks between control responses
+#define CONTROL_PERIOD 10
+
+// Clock ticks the producer keeps the link saturated for during a baud rate switch
+#define SWITCH_TICKS 1000
+
+static uint8_t TicksPerPacket;	/*!< Telemetry packets produced each clock tick, 0 for none */
+static uint32_t NbTicks;	/*!< The number of clock ticks since the producer started */
+
+/*!
+ * @struct TClassStats
+ */
+typedef struct
+{
+  uint8_t depth;		/*!< The frames queued when the statistics were asked for */
+  uint8_t maxDepth;		/*!< The most frames queued at once */
+  uint16_t latency;		/*!< The mean clock ticks from commit to the start of sending */
+  uint16_t latencyMax;		/*!< The most clock ticks from commit to the start of sending */
+  uint16_t dropped;		/*!< The number of frames dropped */
+} TClassStats;
+
+/*! @brief Sends whatever the transmit DMA has been given, for the simulated clock tick.
+ *
+ *  @return void.
+ */
+static void Tick(void)
+{
+  (void)HostUART_Transmit(BYTES_PER_TICK);
+}
+
+/*! @brief Sends for the simulated clock tick, and produces telemetry faster than the link sends it.
+ *
+ *  @return void.
+ */
+static void Produce(void)
+{
+  Tick();
+  if (NbTicks++ >= SWITCH_TICKS)
+    return;
+  for (uint8_t packetNb = 0; packetNb < TicksPerPacket; packetNb++)
+    Packet_PutTelemetry(0x73, packetNb, (uint8_t)NbTicks, (uint8_t)(NbTicks >> 8));
+}
+
+/*! @brief Sends everything queued.
+ *
+ *  @return void.
+ */
+static void Drain(void)
+{
+  while (HostUART_Transmit(BYTES_PER_TICK))
+    ;
+}
+
+/*! @brief Sends a UART control command.
+ *
+ *  @param control The UART control command.
+ *  @param value The data sent with the command.
+ *  @return void.
+ */
+static void Control(const TUARTControl control, const uint16_t value)
+{
+  uint16union_t data;
+
+  data.l = value;
+  CHECK(UART_Control(control, data), "UART control %u with %u rejected", control, value);
+}
+
+/*! @brief Gets a class's statistics the way the PC does.
+ *
+ *  @param class The transmit class.
+ *  @param stats Where the statistics are placed.
+ *  @return void.
+ */
+static void ClassStats(const TUARTClass class, TClassStats* const stats)
+{
+  uint32_t mark = HostUART_NbSent;
+
+  // The depth is taken when the command is handled, and the replies are found among what was queued
+  Control(UART_CLASS_STATS, class);
+  Drain();
+
+  for (uint32_t byte = mark; byte + PACKET_NB_BYTES <= HostUART_NbSent; byte += PACKET_NB_BYTES)
+  {
+    const uint8_t* packet = &HostUART_Sent[byte];
+    uint16_t value = packet[2] | (packet[3] << 8);
+
+    if (packet[0] != UART_COMMAND)
+      continue;
+    switch (packet[1])
+    {
+      case UART_CLASS_DEPTH:
+	stats->depth = packet[2];
+	stats->maxDepth = packet[3];
+	break;
+      case UART_CLASS_LATENCY:
+	stats->latency = value;
+	break;
+      case UART_CLASS_LATENCY_MAX:
+	stats->latencyMax = value;
+	break;
+      case UART_CLASS_DROPPED:
+	stats->dropped = value;
+	break;
+    }
+  }
+}
+
+/*! @brief Checks the limit holds while the oldest telemetry frame is being sent.
+ *
+ *  @return void.
+ */
+static void TestLimit(void)
+{
+  TClassStats stats;
+  uint32_t mark = HostUART_NbSent;
+  const uint8_t expected[] = {0, 8, 9, 10};
+  uint8_t sent[sizeof(expected)];
+  uint8_t nbSent = 0;
+
+  Control(UART_TELEMETRY_LIMIT, 4);
+  Control(UART_STATS_RESET, 0);
+
+  // The first packet goes straight to the DMA, and stays there while the rest are queued
+  for (uint8_t packetNb = 0; packetNb <= 10; packetNb++)
+    Packet_PutTelemetry(0x70, packetNb, 0, 0);
+  ClassStats(UART_CLASS_TELEMETRY, &stats);
+
+  CHECK(stats.depth == 4, "%u telemetry frames queued with a limit of 4", stats.depth);
+  CHECK(stats.maxDepth == 4, "%u telemetry frames queued at most with a limit of 4", stats.maxDepth);
+  CHECK(stats.dropped == 7, "%u of 7 telemetry frames dropped", stats.dropped);
+
+  // The frame on the wire went out whole, then the replies, then the newest telemetry
+  for (uint32_t byte = mark; byte + PACKET_NB_BYTES <= HostUART_NbSent; byte += PACKET_NB_BYTES)
+    if ((HostUART_Sent[byte] == 0x70) && (nbSent < sizeof(sent)))
+      sent[nbSent++] = HostUART_Sent[byte + 1];
+  CHECK((nbSent == sizeof(expected)) && (memcmp(sent, expected, sizeof(expected)) == 0) && (HostUART_Sent[mark] == 0x70),
+	"%u telemetry packets sent, from %u", nbSent, sent[0]);
+}
+
+/*! @brief Checks a baud rate switch holds back the queued telemetry rather than waiting for it to run out.
+ *
+ *  @return void.
+ */
+static void TestBaudSwitch(void)
+{
+  uint16union_t data;
+  uint32_t mark;
+
+  Control(UART_TELEMETRY_LIMIT, 8);
+  Drain();
+  HostUART_NbSent = 0;
+
+  // Telemetry keeps the class queue full, so the DMA ISR always has a frame to chain
+  TicksPerPacket = 3;
+  NbTicks = 0;
+  HostOS_SetIdle(Produce);
+  OS_TimeDelay(20);
+
+  data.l = 2304;
+  CHECK(UART_Control(UART_BAUD_SWITCH, data), "switch to 230400 baud rejected");
+  mark = NbTicks;
+  CHECK(UART_BaudUpdate() == UART_BAUD_TIMEOUT, "no switch to 230400 baud");
+  CHECK(NbTicks - mark <= 2, "switch waited %u ticks on a saturated link", NbTicks - mark);
+  CHECK(HostUART_Divisor() == (2 * MODULE_CLK + 230400 / 2) / 230400, "divisor %u at 230400 baud", HostUART_Divisor());
+  CHECK(HostUART_NbSent % PACKET_NB_BYTES == 0, "switched with %u bytes of a frame sent", HostUART_NbSent % PACKET_NB_BYTES);
+
+  // The held frames go out at the new rate
+  mark = HostUART_NbSent;
+  OS_TimeDelay(20);
+  CHECK(HostUART_NbSent - mark >= 20 * BYTES_PER_TICK, "%u bytes sent after the switch", HostUART_NbSent - mark);
+
+  HostOS_SetIdle(Tick);
+  UART_BaudFallback();
+  Drain();
+  CHECK(HostUART_Divisor() == (2 * MODULE_CLK + BAUD_RATE / 2) / BAUD_RATE, "divisor %u after the fallback", HostUART_Divisor());
+  HostUART_NbSent = 0;
+}
+
+/*! @brief Runs telemetry faster than the link and control responses among it, and prints the statistics.
+ *
+ *  @param limit The telemetry limit, 0 for the producer to wait for space.
+ *  @param perTick The telemetry packets produced each clock tick.
+ *  @param control Where the control class's statistics are placed.
+ *  @param telemetry Where the telemetry class's statistics are placed.
+ *  @return void.
+ */
+static void Load(const uint16_t limit, const uint8_t perTick, TClassStats* const control, TClassStats* const telemetry)
+{
+  Control(UART_TELEMETRY_LIMIT, limit);
+  Drain();
+  Control(UART_STATS_RESET, 0);
+
+  for (uint32_t tick = 0; tick < NB_TICKS; tick++)
+  {
+    for (uint8_t packetNb = 0; packetNb < perTick; packetNb++)
+      Packet_PutTelemetry(0x71, packetNb, (uint8_t)tick, (uint8_t)(tick >> 8));
+    if (tick % CONTROL_PERIOD == 0)
+      Packet_Put(0x72, (uint8_t)tick, (uint8_t)(tick >> 8), 0);
+    OS_TimeDelay(1);
+  }
+
+  // Only what is sent from here is looked at, so a long load does not run off the end of what the model keeps
+  HostUART_NbSent = 0;
+  ClassStats(UART_CLASS_CONTROL, control);
+  ClassStats(UART_CLASS_TELEMETRY, telemetry);
+  printf("  %5u %8u bytes/tick   control %4u ticks mean %4u max   telemetry %4u ticks mean %4u max %3u deep %6u dropped\n",
+	 limit, perTick * PACKET_NB_BYTES, control->latency, control->latencyMax,
+	 telemetry->latency, telemetry->latencyMax, telemetry->maxDepth, telemetry->dropped);
+}
+
+int main(void)
+{
+  TClassStats control, telemetry;
+
+  HostUART_Reset();
+  HostOS_SetIdle(Tick);
+  CHECK(UART_Init(BAUD_RATE, MODULE_CLK, NULL, NULL), "UART_Init failed");
+
+  TestLimit();
+  TestBaudSwitch();
+
+  // Telemetry at 15 bytes a tick on a link sending 12
+  printf("  limit telemetry              control latency             telemetry latency, depth and drops\n");
+  Load(0, 3, &control, &telemetry);
+  CHECK(control.latencyMax <= 1, "control waited %u ticks behind telemetry", control.latencyMax);
+  CHECK(telemetry.dropped == 0, "telemetry dropped with no limit");
+
+  for (uint16_t limit = 4; limit <= 32; limit *= 2)
+  {
+    Load(limit, 3, &control, &telemetry);
+    CHECK(control.latencyMax <= 1, "control waited %u ticks behind telemetry", control.latencyMax);
+    CHECK(telemetry.maxDepth <= limit, "%u telemetry frames queued with a limit of %u", telemetry.maxDepth, limit);
+    CHECK(telemetry.dropped > 0, "no telemetry dropped on a saturated link");
+  }
+
+  return CHECK_DONE("tx_classes");
+}
@@ -0,0 +1,274 @@
+/*! @file
+ *
+ *  @brief UART module on a model of UART2 and its eDMA channels.
+ *
+ *  Runs the UART module against the register model in Host/, and checks where the receive DMA's
+ *  position says the bytes are, what the idle line and half ring interrupts publish, that overrun
+ *  bytes are counted, and that transmit frames are released in class order and free space for
+ *  producers waiting on it. The baud rate switch is checked to wait for the frame on the wire.
+ *
+ *  @author Mohammad Yasin Azimi
+ *  @date 2016-11-09
+ */
+#include "check.h"
+#include "OS.h"
+#include "ring.h"
+#include "UART.h"
+#include "packet.h"
+#include "MK70F12.h"
+
+// The bus clock the UART runs from, and the baud rate UART_Init sets
+#define MODULE_CLK 25000000
+#define BAUD_RATE 115200
+
+// Bytes sent per clock tick, about 115200 baud at a 1 ms tick
+#define BYTES_PER_TICK 12
+
+static uint32_t NbReceived;	/*!< The number of bytes put on the receive line */
+static uint32_t NbTaken;	/*!< The number of bytes taken from the UART module */
+
+/*! @brief Gets the byte in a position of the received stream.
+ *
+ *  The pattern does not repeat every RING_SIZE bytes, so a byte taken from the wrong lap shows up.
+ *  @param position The position in the stream.
+ *  @return uint8_t - The byte.
+ */
+static uint8_t StreamByte(const uint32_t position)
+{
+  return (uint8_t)(position * 7 + (position >> 8));
+}
+
+/*! @brief Puts the next bytes of the stream on the receive line.
+ *
+ *  @param length The number of bytes.
+ *  @return void.
+ */
+static void Receive(const uint16_t length)
+{
+  uint8_t data[1024];
+
+  for (uint16_t byte = 0; byte < length; byte++)
+    data[byte] = StreamByte(NbReceived++);
+  HostUART_Receive(data, length);
+}
+
+/*! @brief Takes bytes from the UART module and checks they are the next bytes of the stream.
+ *
+ *  @param length The number of bytes.
+ *  @return void.
+ */
+static void Take(const uint16_t length)
+{
+  uint8_t data[RING_SIZE];
+  uint16_t nbWrong = 0;
+
+  UART_InBlock(data, length);
+  for (uint16_t byte = 0; byte < length; byte++)
+    if (data[byte] != StreamByte(NbTaken + byte))
+      nbWrong++;
+  CHECK(nbWrong == 0, "%u of %u bytes from position %u wrong", nbWrong, length, NbTaken);
+  NbTaken += length;
+}
+
+/*! @brief Sends whatever the transmit DMA has been given, for the simulated clock tick.
+ *
+ *  @return void.
+ */
+static void Tick(void)
+{
+  (void)HostUART_Transmit(BYTES_PER_TICK);
+}
+
+/*! @brief Sends everything queued.
+ *
+ *  @return void.
+ */
+static void Drain(void)
+{
+  while (HostUART_Transmit(BYTES_PER_TICK))
+    ;
+}
+
+/*! @brief Sends a UART control command and finds a value it reports.
+ *
+ *  @param control The UART control command.
+ *  @param value The parameter 1 of the reply packet wanted.
+ *  @return uint16_t - Parameters 2 and 3 of the reply packet, or 0xFFFF if there was none.
+ */
+static uint16_t Report(const TUARTControl control, const uint8_t value)
+{
+  uint16union_t data;
+  uint32_t mark = HostUART_NbSent;
+  uint16_t result = 0xFFFF;
+
+  data.l = 0;
+  CHECK(UART_Control(control, data), "UART control %u rejected", control);
+  Drain();
+
+  for (uint32_t byte = mark; byte + PACKET_NB_BYTES <= HostUART_NbSent; byte += PACKET_NB_BYTES)
+    if ((HostUART_Sent[byte] == UART_COMMAND) && (HostUART_Sent[byte + 1] == value))
+      result = HostUART_Sent[byte + 2] | (HostUART_Sent[byte + 3] << 8);
+
+  return result;
+}
+
+/*! @brief Checks the receive ring follows the DMA's write position.
+ *
+ *  @return void.
+ */
+static void TestPosition(void)
+{
+  // A short burst is published when the line goes idle, not before
+  Receive(10);
+  CHECK(UART_InCount() == 0, "%u bytes published before the line went idle", UART_InCount());
+  HostUART_Idle();
+  CHECK(UART_InCount() == 10, "%u of 10 bytes published at idle", UART_InCount());
+  Take(10);
+
+  // Filling half the ring publishes it without waiting for the line to go idle
+  Receive(RING_SIZE / 2 - 10);
+  CHECK(UART_InCount() == RING_SIZE / 2 - 10, "%u bytes published at the half ring interrupt", UART_InCount());
+
+  // The major loop interrupt publishes up to the end of the buffer, and idle the rest after the wrap
+  Receive(RING_SIZE / 2 + 10);
+  CHECK(UART_InCount() == RING_SIZE - 10, "%u bytes published at the major loop interrupt", UART_InCount());
+  Take(RING_SIZE - 10);
+  HostUART_Idle();
+  CHECK(UART_InCount() == 10, "%u of 10 bytes published after the wrap", UART_InCount());
+  Take(10);
+}
+
+/*! @brief Checks bytes the DMA writes over before they are taken are counted.
+ *
+ *  @return void.
+ */
+static void TestOverrun(void)
+{
+  uint16_t overruns;
+
+  CHECK(Report(UART_STATUS_CHECK, UART_RX_OVERRUNS_LO) == 0, "overruns counted before any");
+
+  // The DMA laps the consumer by 44 bytes in one burst
+  Receive(300);
+  HostUART_Idle();
+  CHECK(UART_InCount() == RING_SIZE, "%u bytes published in a full ring", UART_InCount());
+  overruns = Report(UART_STATUS_CHECK, UART_RX_OVERRUNS_LO);
+  CHECK(overruns == 300 - RING_SIZE, "%u overruns counted for %u", overruns, 300 - RING_SIZE);
+
+  // Bytes left over from the overrun are not counted again, only the new ones that add to it
+  Receive(10);
+  HostUART_Idle();
+  overruns = Report(UART_STATUS_CHECK, UART_RX_OVERRUNS_LO);
+  CHECK(overruns == 300 - RING_SIZE + 10, "%u overruns counted for %u", overruns, 300 - RING_SIZE + 10);
+
+  // Once the consumer catches up the rest is published and nothing more is counted
+  UART_InSkip(RING_SIZE);
+  HostUART_Idle();
+  CHECK(UART_InCount() == 300 - RING_SIZE + 10, "%u bytes published after the overrun", UART_InCount());
+  UART_InSkip(UART_InCount());
+  overruns = Report(UART_STATUS_CHECK, UART_RX_OVERRUNS_LO);
+  CHECK(overruns == 300 - RING_SIZE + 10, "%u overruns counted once caught up", overruns);
+  NbTaken = NbReceived;
+
+  // The stream is back in step, and the counter resets with the others
+  Receive(RING_SIZE / 2);
+  HostUART_Idle();
+  Take(RING_SIZE / 2);
+  CHECK(Report(UART_STATS_RESET, 0) == 0xFFFF, "statistics reset replied");
+  CHECK(Report(UART_STATUS_CHECK, UART_RX_OVERRUNS_LO) == 0, "overruns not reset");
+  CHECK(Report(UART_STATUS_CHECK, UART_RX_BYTES_LO) == 0, "received bytes not reset");
+}
+
+/*! @brief Checks control frames go out ahead of queued telemetry, each class in order.
+ *
+ *  @return void.
+ */
+static void TestClasses(void)
+{
+  uint32_t mark = HostUART_NbSent;
+  const uint8_t expected[] = {0x10, 0x20, 0x11, 0x12};
+
+  // The first telemetry packet starts the DMA, and the rest queue behind it
+  Packet_PutTelemetry(0x10, 1, 2, 3);
+  Packet_PutTelemetry(0x11, 1, 2, 3);
+  Packet_PutTelemetry(0x12, 1, 2, 3);
+  Packet_Put(0x20, 1, 2, 3);
+  Drain();
+
+  CHECK(HostUART_NbSent - mark == sizeof(expected) * PACKET_NB_BYTES, "%u bytes sent for 4 packets", HostUART_NbSent - mark);
+  for (uint8_t packetNb = 0; packetNb < sizeof(expected); packetNb++)
+  {
+    const uint8_t* packet = &HostUART_Sent[mark + packetNb * PACKET_NB_BYTES];
+
+    CHECK(packet[0] == expected[packetNb], "packet %u is 0x%02X, not 0x%02X", packetNb, packet[0], expected[packetNb]);
+    CHECK(packet[4] == (packet[0] ^ packet[1] ^ packet[2] ^ packet[3]), "packet %u checksum", packetNb);
+  }
+}
+
+/*! @brief Checks a producer waiting for transmit space is woken as frames are released.
+ *
+ *  @return void.
+ */
+static void TestSpace(void)
+{
+  static uint8_t block[32000];
+  uint32_t mark = HostUART_NbSent;
+  uint32_t nbWrong = 0;
+
+  // Many times the transmit buffer, so UART_OutBlock waits for the DMA again and again
+  for (uint32_t byte = 0; byte < sizeof(block); byte++)
+    block[byte] = StreamByte(byte);
+  UART_OutBlock(block, sizeof(block));
+  Drain();
+
+  CHECK(HostUART_NbSent - mark == sizeof(block), "%u of %u bytes sent", HostUART_NbSent - mark, (uint32_t)sizeof(block));
+  for (uint32_t byte = 0; byte < sizeof(block); byte++)
+    if (HostUART_Sent[mark + byte] != block[byte])
+      nbWrong++;
+  CHECK(nbWrong == 0, "%u bytes of the block sent wrong", nbWrong);
+}
+
+/*! @brief Checks a baud rate switch waits for the frame being sent.
+ *
+ *  @return void.
+ */
+static void TestBaudSwitch(void)
+{
+  uint16union_t data;
+  uint32_t mark = HostUART_NbSent;
+
+  data.l = 2304;
+  Packet_Put(0x30, 1, 2, 3);
+  CHECK(UART_Control(UART_BAUD_SWITCH, data), "switch to 230400 baud rejected");
+  CHECK(UART_BaudUpdate() == UART_BAUD_TIMEOUT, "no switch to 230400 baud");
+  CHECK(HostUART_NbSent - mark == PACKET_NB_BYTES, "switched with %u of %u bytes sent", HostUART_NbSent - mark, PACKET_NB_BYTES);
+  CHECK(HostUART_Divisor() == (2 * MODULE_CLK + 230400 / 2) / 230400, "divisor %u at 230400 baud", HostUART_Divisor());
+  CHECK((UART2_C2 & (UART_C2_TE_MASK | UART_C2_RE_MASK)) == (UART_C2_TE_MASK | UART_C2_RE_MASK), "UART left disabled");
+
+  // Frames go out again at the new rate, and the fallback restores the first
+  Packet_Put(0x31, 1, 2, 3);
+  Drain();
+  CHECK(HostUART_NbSent - mark == 2 * PACKET_NB_BYTES, "frame after the switch not sent");
+  UART_BaudFallback();
+  CHECK(HostUART_Divisor() == (2 * MODULE_CLK + BAUD_RATE / 2) / BAUD_RATE, "divisor %u after the fallback", HostUART_Divisor());
+}
+
+int main(void)
+{
+  HostUART_Reset();
+  HostOS_SetIdle(Tick);
+
+  CHECK(UART_Init(BAUD_RATE, MODULE_CLK, NULL, NULL), "UART_Init failed");
+  CHECK(HostUART_Divisor() == (2 * MODULE_CLK + BAUD_RATE / 2) / BAUD_RATE, "divisor %u at %u baud", HostUART_Divisor(), BAUD_RATE);
+
+  // Lets the model see the receive DMA request UART_Init enabled
+  (void)HostUART_Transmit(0);
+
+  TestPosition();
+  TestOverrun();
+  TestClasses();
+  TestSpace();
+  TestBaudSwitch();
+
+  return CHECK_DONE("uart_model");
+}